@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <benchmark/benchmark.h>
+
+#include "../include/Graph.hpp"
+#include "../include/ThresholdMask.hpp"
+
+namespace
+{
+    // A set of transactions in the FIMI format along with the support used to mine it
+    struct Dataset {
+      std::string name;
+      std::string transactions;
+      size_t transactionCount{};
+      int minSupport{};
+    };
+
+    /**
+     * \brief Generates transactions whose items follow a skewed popularity so that mining finds non-trivial FIs
+     * \param transactions The number of transactions
+     * \param items The size of the item universe
+     * \param averageLength The average number of items per transaction
+     * \return The transactions in the FIMI format
+     */
+    std::string syntheticTransactions(const size_t transactions, const size_t items, const size_t averageLength)
+    {
+        std::mt19937_64 random(42);
+        std::uniform_int_distribution<size_t> length(1, 2 * averageLength - 1);
+        std::uniform_real_distribution<double> popularity(0.0, 1.0);
+
+        std::string str;
+        for (size_t i = 0; i < transactions; ++i)
+        {
+            const size_t count = length(random);
+            for (size_t j = 0; j < count; ++j)
+            {
+                const double u = popularity(random);
+                str += std::to_string(static_cast<size_t>(u * u * static_cast<double>(items)));
+                str += j + 1 == count ? '\n' : ' ';
+            }
+        }
+
+        return str;
+    }
+
+    /**
+     * \brief Reads up to maxTransactions lines of a FIMI dataset file
+     * \return The transactions and how many there are, no transactions if the file cannot be read
+     */
+    std::pair<std::string, size_t> readDataset(const std::filesystem::path &path, const size_t maxTransactions)
+    {
+        std::ifstream fstream(path);
+        std::string str;
+        std::string line;
+        size_t count = 0;
+        while (count < maxTransactions && std::getline(fstream, line))
+        {
+            str += line;
+            str += '\n';
+            ++count;
+        }
+
+        return {str, count};
+    }
+
+    Graph buildGraph(const Dataset &dataset)
+    {
+        Graph graph(1);
+        std::istringstream stream(dataset.transactions);
+        graph.processTransactions(stream);
+
+        return graph;
+    }
+
+    void processTransactions(benchmark::State &state, const std::shared_ptr<const Dataset> &dataset)
+    {
+        for (auto _ : state)
+        {
+            benchmark::DoNotOptimize(buildGraph(*dataset));
+        }
+
+        state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * dataset->transactionCount));
+        state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * dataset->transactions.size()));
+    }
+
+    void buildClm(benchmark::State &state, const std::shared_ptr<const Dataset> &dataset)
+    {
+        Graph graph = buildGraph(*dataset);
+        for (auto _ : state)
+        {
+            graph.rebuildClm(static_cast<size_t>(state.range(0)));
+        }
+    }
+
+    void mine(benchmark::State &state, const std::shared_ptr<const Dataset> &dataset)
+    {
+        Graph graph = buildGraph(*dataset);
+        for (auto _ : state)
+        {
+            benchmark::DoNotOptimize(graph.useCLM_Miner(dataset->minSupport, static_cast<size_t>(state.range(0))));
+        }
+    }
+
+    void mineTopK(benchmark::State &state, const std::shared_ptr<const Dataset> &dataset)
+    {
+        Graph graph = buildGraph(*dataset);
+        for (auto _ : state)
+        {
+            benchmark::DoNotOptimize(graph.useTopK_Miner(static_cast<size_t>(state.range(0)), 1));
+        }
+    }
+
+    void jsonRoundTrip(benchmark::State &state, const std::shared_ptr<const Dataset> &dataset)
+    {
+        const Graph graph = buildGraph(*dataset);
+        for (auto _ : state)
+        {
+            std::stringstream image;
+            graph.writeImage(image);
+            const auto bytes = static_cast<size_t>(image.tellp());
+            benchmark::DoNotOptimize(Graph::loadImage(image));
+            state.counters["image_bytes"] = static_cast<double>(bytes);
+        }
+    }
+
+    void registerDataset(const std::shared_ptr<const Dataset> &dataset)
+    {
+        benchmark::RegisterBenchmark(("processTransactions/" + dataset->name).c_str(), processTransactions, dataset)
+                ->Unit(benchmark::kMillisecond);
+        benchmark::RegisterBenchmark(("buildClm/" + dataset->name).c_str(), buildClm, dataset)
+                ->ArgName("threads")->Arg(1)->Arg(4)->Unit(benchmark::kMillisecond)->UseRealTime();
+        benchmark::RegisterBenchmark(("useCLM_Miner/" + dataset->name).c_str(), mine, dataset)
+                ->ArgName("threads")->Arg(1)->Arg(4)->Unit(benchmark::kMillisecond)->UseRealTime();
+        benchmark::RegisterBenchmark(("useTopK_Miner/" + dataset->name).c_str(), mineTopK, dataset)
+                ->ArgName("k")->Arg(100)->Arg(1000)->Unit(benchmark::kMillisecond);
+        benchmark::RegisterBenchmark(("jsonRoundTrip/" + dataset->name).c_str(), jsonRoundTrip, dataset)
+                ->Unit(benchmark::kMillisecond);
+    }
+
+    int relativeSupport(const size_t transactions, const double fraction)
+    {
+        return std::max(1, static_cast<int>(static_cast<double>(transactions) * fraction));
+    }
+}
+
+int main(int argc, char **argv)
+{
+    // Synthetic datasets over a small and a large item universe
+    for (const size_t items : {50, 1000})
+    {
+        for (const size_t transactions : {1'000, 10'000, 100'000})
+        {
+            const auto dataset = std::make_shared<Dataset>();
+            dataset->name = "synthetic-" + std::to_string(items) + "i/" + std::to_string(transactions);
+            dataset->transactions = syntheticTransactions(transactions, items, 8);
+            dataset->transactionCount = transactions;
+            dataset->minSupport = relativeSupport(transactions, 0.01);
+            registerDataset(dataset);
+        }
+    }
+
+    // Standard FIMI datasets, read as <name>.dat from the directory in CLM_BENCH_DATA when it is set
+    if (const char *dataDirectory = std::getenv("CLM_BENCH_DATA"))
+    {
+        const std::vector<std::pair<std::string, double>> datasets{
+            {"retail", 0.01}, {"T10I4D100K", 0.01}, {"chess", 0.8}, {"mushroom", 0.4}};
+
+        for (const auto &[name, support] : datasets)
+        {
+            size_t previousCount = 0;
+            for (const size_t maxTransactions : {size_t{1'000}, size_t{10'000}, std::numeric_limits<size_t>::max()})
+            {
+                auto [transactions, count] =
+                        readDataset(std::filesystem::path(dataDirectory) / (name + ".dat"), maxTransactions);
+
+                // Skip missing files and sizes that already cover the whole file
+                if (count == 0 || count == previousCount)
+                    break;
+                previousCount = count;
+
+                const auto dataset = std::make_shared<Dataset>();
+                dataset->name = name + "/" + std::to_string(count);
+                dataset->transactions = std::move(transactions);
+                dataset->transactionCount = count;
+                dataset->minSupport = relativeSupport(count, support);
+                registerDataset(dataset);
+            }
+        }
+    }
+
+    benchmark::AddCustomContext("threshold_kernel", ThresholdMask::kernel());
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    return 0;
+}
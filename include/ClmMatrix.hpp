@@ -0,0 +1,238 @@
+#ifndef CLM_MATRIX_H
+#define CLM_MATRIX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <span>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+#include "ItemDictionary.hpp"
+#include "ThresholdMask.hpp"
+
+/**
+ * \brief The CLM, every row belongs to a from item and holds a major column for every to item followed by a minor
+ * column for every extra item, a cell is addressed by (row, major, minor) where a minor of majorCell selects the major
+ * column itself
+ */
+class ClmMatrix
+{
+public:
+    enum class Layout
+    {
+        Auto, // Dense for alphabets up to denseLimit items, sparse otherwise
+        Dense, // Every row is maxNodes * (maxNodes + 1) cells of one contiguous buffer
+        Sparse // Every row is a hash of the non-zero (major, minor) cells, the hash nodes dwarf the width of a count
+    };
+
+    static constexpr ItemId majorCell = ItemDictionary::npos;
+    static constexpr size_t denseLimit = 128;
+    static constexpr size_t cacheLine = 64;
+
+    // A non-zero cell of a sparse row, the key packs its major and minor column the same way as the row hash does
+    struct SparseCell {
+      uint64_t key{};
+      uint64_t count{};
+    };
+
+private:
+    /**
+     * \brief Allocates on cache line boundaries so that every dense row starts on its own cache line
+     */
+    template <typename T>
+    struct CacheAlignedAllocator {
+      using value_type = T;
+
+      CacheAlignedAllocator() = default;
+
+      template <typename U>
+      explicit CacheAlignedAllocator(const CacheAlignedAllocator<U> &) noexcept {}
+
+      T *allocate(const size_t n)
+      {
+          return static_cast<T *>(::operator new(n * sizeof(T), std::align_val_t{cacheLine}));
+      }
+
+      void deallocate(T *pointer, const size_t n) noexcept
+      {
+          ::operator delete(pointer, n * sizeof(T), std::align_val_t{cacheLine});
+      }
+
+      template <typename U>
+      bool operator==(const CacheAlignedAllocator<U> &) const noexcept
+      {
+          return true;
+      }
+    };
+
+    template <typename T>
+    using DenseCells = std::vector<T, CacheAlignedAllocator<T>>;
+
+    Layout layout = Layout::Dense;
+    size_t maxNodes = 1;
+    size_t rowSize = maxNodes * maxNodes + maxNodes;
+
+    // Dense rows are stored row-major by item ID, rowStride is rowSize rounded up to whole cache lines. Cells start 16
+    // bits wide and the whole buffer is promoted to the next width when a count no longer fits
+    size_t rowStride = 0;
+    std::variant<DenseCells<uint16_t>, DenseCells<uint32_t>, DenseCells<uint64_t>> denseCells;
+    std::vector<std::unordered_map<uint64_t, size_t>> sparseRows; // Indexed by item ID
+    std::vector<bool> rows; // Whether the row of an item ID exists
+
+    /**
+     * \brief Replaces the dense buffer with one of the given width holding the same counts
+     */
+    template <typename T>
+    void resizeDenseCells();
+
+    /**
+     * \brief Promotes the dense buffer to the next cell width
+     */
+    void widenDenseCells();
+
+    /**
+     * \brief Maps a cell to its key in a sparse row, the major cell maps to a minor of 0 and minors are shifted by one
+     */
+    [[nodiscard]] static uint64_t sparseKey(ItemId major, ItemId minor) noexcept;
+
+public:
+    ClmMatrix() : ClmMatrix(Layout::Dense, 1) {}
+
+    /**
+     * \brief Creates an empty CLM
+     * \param layout The storage layout, Auto is resolved using maxNodes
+     * \param maxNodes The number of items the CLM has columns for, only dense rows are limited by it
+     */
+    ClmMatrix(Layout layout, size_t maxNodes);
+
+    [[nodiscard]] Layout getLayout() const noexcept;
+
+    /**
+     * \brief Creates an all zero row if the row does not exist yet
+     * \param row The from item of the row
+     * \throws std::out_of_range If the layout is dense and the row is not below maxNodes
+     */
+    void ensureRow(ItemId row);
+
+    [[nodiscard]] bool hasRow(ItemId row) const noexcept;
+
+    /**
+     * \brief Promotes the dense cells up front so that counts up to count fit without promoting again, after this adds
+     * to different existing rows may run concurrently
+     * \param count The largest count a cell will reach
+     */
+    void reserveCount(size_t count);
+
+    /**
+     * \brief Scans a dense row for the cells that reach a threshold
+     * \param row The from item
+     * \param threshold The minimum count of a cell
+     * \param mask The mask to fill, bit denseIndex(major, minor) is set for every cell that reaches the threshold
+     * \return False without touching the mask for sparse layouts and rows that do not exist
+     */
+    bool scanRow(ItemId row, size_t threshold, ThresholdMask &mask) const;
+
+    /**
+     * \brief Gets the number of bytes of a dense cell, which is 2, 4 or 8 depending on the largest count so far
+     */
+    [[nodiscard]] size_t getCellBytes() const noexcept;
+
+    /**
+     * \brief Gets the dense cells as they are laid out in memory, getCellBytes wide each
+     * \return The bytes of every dense row, empty for the sparse layout
+     */
+    [[nodiscard]] std::span<const char> denseBytes() const noexcept;
+
+    /**
+     * \brief Creates a dense CLM from the bytes of denseBytes, the rows still have to be marked with ensureRow
+     * \param maxNodes The number of items the CLM has columns for
+     * \param cellBytes The width of a cell, 2, 4 or 8
+     * \param bytes The cells
+     * \throws std::invalid_argument If the width is unknown or the bytes are not a CLM of maxNodes items, checked before
+     * anything is allocated
+     */
+    static ClmMatrix fromDenseBytes(size_t maxNodes, size_t cellBytes, std::span<const char> bytes);
+
+    /**
+     * \brief Gets the number of non-zero cells of a sparse row
+     * \return The number of cells, 0 for dense layouts and rows that do not exist
+     */
+    [[nodiscard]] size_t sparseRowSize(ItemId row) const noexcept;
+
+    /**
+     * \brief Lists the non-zero cells of a sparse row ordered by key, so that the same row is always listed the same way
+     * \param row The from item
+     * \param cells The cells of the row, cleared first
+     */
+    void sparseRowCells(ItemId row, std::vector<SparseCell> &cells) const;
+
+    /**
+     * \brief Replaces a sparse row with cells listed by sparseRowCells, sizing its hash for them once up front
+     * \param row The from item
+     * \param cells The cells of the row
+     * \param items The number of items, every column of a cell has to be below it
+     * \throws std::invalid_argument If the layout is not sparse or a cell is zero, repeated or out of range
+     */
+    void assignSparseRow(ItemId row, std::span<const SparseCell> cells, size_t items);
+
+    /**
+     * \brief Maps a cell to its index in a dense row
+     * \param major The to item
+     * \param minor The extra item or majorCell for the major column
+     * \return The index of the cell in the row, which is also its bit in the mask filled by scanRow
+     */
+    [[nodiscard]] size_t denseIndex(ItemId major, ItemId minor = majorCell) const noexcept;
+
+    /**
+     * \brief Gets the count of a cell
+     * \param row The from item
+     * \param major The to item
+     * \param minor The extra item or majorCell for the major column
+     * \return The count of the cell, 0 for cells that were never set
+     */
+    [[nodiscard]] size_t get(ItemId row, ItemId major, ItemId minor = majorCell) const noexcept;
+
+    void set(ItemId row, ItemId major, ItemId minor, size_t count);
+
+    void add(ItemId row, ItemId major, ItemId minor, size_t count);
+
+    /**
+     * \brief Visits every non-zero cell of a row as (major, minor, count), in column order for dense rows and in no
+     * particular order for sparse rows
+     */
+    template <typename Visitor>
+    void forEachCell(const ItemId row, Visitor &&visitor) const
+    {
+        if (layout == Layout::Sparse)
+        {
+            if (!hasRow(row))
+                return;
+
+            for (const auto &[key, count] : sparseRows[row])
+            {
+                visitor(static_cast<ItemId>(key >> 32), static_cast<ItemId>((key & 0xFFFFFFFF) - 1), count);
+            }
+            return;
+        }
+
+        if (!hasRow(row))
+            return;
+
+        std::visit([&](const auto &cells)
+        {
+            const auto *cell = cells.data() + row * rowStride;
+            for (size_t i = 0; i < rowSize; ++i)
+            {
+                if (cell[i] != 0)
+                {
+                    const size_t column = i % (maxNodes + 1);
+                    visitor(static_cast<ItemId>(i / (maxNodes + 1)),
+                            column == 0 ? majorCell : static_cast<ItemId>(column - 1), static_cast<size_t>(cell[i]));
+                }
+            }
+        }, denseCells);
+    }
+};
+
+#endif // CLM_MATRIX_H
@@ -0,0 +1,52 @@
+#ifndef FREQUENT_ITEMSETS_H
+#define FREQUENT_ITEMSETS_H
+
+#include <cstddef>
+#include <span>
+#include <vector>
+#include "ItemDictionary.hpp"
+
+/**
+ * \brief A flat set of FIs, the items of every FI lie one after another in a single buffer with the offset at which
+ * each FI starts and its support count next to it, so adding an FI never allocates on its own
+ */
+class FrequentItemsets
+{
+    std::vector<ItemId> itemBuffer;
+    std::vector<size_t> offsets{0}; // FI i is itemBuffer[offsets[i], offsets[i + 1])
+    std::vector<size_t> supports;
+
+public:
+    /**
+     * \brief Adds an FI after the others
+     * \param items The items of the FI
+     * \param support The support count of the FI
+     */
+    void add(std::span<const ItemId> items, size_t support);
+
+    [[nodiscard]] size_t size() const noexcept
+    {
+        return supports.size();
+    }
+
+    [[nodiscard]] bool empty() const noexcept
+    {
+        return supports.empty();
+    }
+
+    /**
+     * \brief Gets the items of an FI, the view is invalidated by adding more FIs
+     * \param i The position of the FI
+     */
+    [[nodiscard]] std::span<const ItemId> items(const size_t i) const noexcept
+    {
+        return {itemBuffer.data() + offsets[i], offsets[i + 1] - offsets[i]};
+    }
+
+    [[nodiscard]] size_t support(const size_t i) const noexcept
+    {
+        return supports[i];
+    }
+};
+
+#endif // FREQUENT_ITEMSETS_H
@@ -1,37 +1,133 @@
 #ifndef GRAPH_H
 #define GRAPH_H
 
-#include <list>
+#include <atomic>
+#include <functional>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <span>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "ClmMatrix.hpp"
+#include "FrequentItemsets.hpp"
+#include "ItemDictionary.hpp"
+#include "JsonWriter.hpp"
+#include "SuffixPool.hpp"
 #include "json.hpp"
 
 class Graph
 {
-    struct Node {
-      char label{};
-      size_t occurrence{};
+public:
+    // Which FIs the miner reports
+    enum class MiningMode
+    {
+        All, // Every FI
+        Maximal, // Only the FIs without a frequent superset
+        Closed // Only the FIs without a superset of the same support
+    };
 
-      bool operator<(const Node & rhs) const {
-        return label < rhs.label;
-      }
+    // Receives every FI found as its items in the canonical order and its support count
+    using FiVisitor = std::function<void(std::span<const ItemId> items, size_t support)>;
 
-      NLOHMANN_DEFINE_TYPE_INTRUSIVE(Node, label, occurrence);
+private:
+    struct Node {
+      ItemId label{};
+      size_t occurrence{};
     };
 
     struct Edge {
-      char from{};
-      char to{};
-      std::list<char> extraNodes;
-      size_t occurrence{};
-
-      NLOHMANN_DEFINE_TYPE_INTRUSIVE(Edge, from, to, extraNodes, occurrence);
+      ItemId from{};
+      ItemId to{};
+      SuffixId extraNodes{}; // Interned in suffixes
+      uint32_t occurrence{}; // Saturates at wideOccurrence, the weight then lives in wideEdgeWeights
     };
 
+    static constexpr uint32_t wideOccurrence = std::numeric_limits<uint32_t>::max();
+    static constexpr size_t noEdge = std::numeric_limits<size_t>::max();
+
     size_t maxNodes = 1;
-    size_t maxRowSize = maxNodes * maxNodes + maxNodes;
-    std::list<Node> nodes;
-    std::list<Edge> edges;
-    std::map<char, std::vector<size_t>> CLM;
+    ItemDictionary dictionary;
+    std::vector<Node> nodes; // Indexed by item ID, the ID of a node is its dense position in the CLM
+    std::vector<Edge> edges;
+    SuffixPool suffixes;
+    ClmMatrix::Layout clmLayout = ClmMatrix::Layout::Auto;
+    ClmMatrix CLM{clmLayout, maxNodes};
+    bool clmCurrent = true; // Whether the CLM matches the nodes and edges, while it does it is updated incrementally
+
+    // Hash of (from, to, extraNodes) -> index into edges, collisions are resolved by comparing the edge itself. Loading
+    // a graph leaves it to be rebuilt by the first transaction or merge, as only adding edges needs it
+    std::unordered_multimap<size_t, size_t> edgeIndex;
+    bool edgeIndexCurrent = true;
+
+    // Index into edges -> weight of the edges whose weight no longer fits their occurrence
+    std::unordered_map<size_t, size_t> wideEdgeWeights;
+
+    /**
+     * \brief Hashes an edge triple into the key used by edgeIndex
+     * \param fromNode The from node
+     * \param toNode The to node
+     * \param extraNodes The extra nodes
+     * \return The hash of the triple
+     */
+    [[nodiscard]] static size_t hashEdge(ItemId fromNode, ItemId toNode, SuffixId extraNodes) noexcept;
+
+    /**
+     * \brief Looks up an edge using the edge index
+     * \param fromNode The from node
+     * \param toNode The to node
+     * \param extraNodes The extra nodes
+     * \return The index of the edge if it exists otherwise noEdge
+     */
+    [[nodiscard]] size_t findEdge(ItemId fromNode, ItemId toNode, SuffixId extraNodes) const noexcept;
+
+    /**
+     * \brief Appends a new edge and adds it to the edge index
+     * \param fromNode The from node
+     * \param toNode The to node
+     * \param extraNodes The extra nodes
+     * \param occurrence The weight of the edge
+     */
+    void addEdge(ItemId fromNode, ItemId toNode, SuffixId extraNodes, size_t occurrence);
+
+    /**
+     * \brief Gets the weight of an edge, including the weights that outgrew its occurrence field
+     * \param edge The index of the edge
+     * \return The weight of the edge
+     */
+    [[nodiscard]] size_t edgeWeight(size_t edge) const noexcept;
+
+    /**
+     * \brief Adds to the weight of an edge, moving the weight into wideEdgeWeights once it no longer fits 32 bits
+     * \param edge The index of the edge
+     * \param occurrence The weight to add
+     */
+    void addEdgeWeight(size_t edge, size_t occurrence);
+
+    /**
+     * \brief Rebuilds the edge index from the edges if they were replaced wholesale since it was last built
+     */
+    void ensureEdgeIndex();
+
+    /**
+     * \brief Gets the ID of a token, adding a node with no occurrences if the token is new
+     * \param token The external token of the item
+     * \return The ID of the item
+     */
+    ItemId internItem(std::string_view token);
+
+    /**
+     * \brief Checks that an edge read from an image is in the canonical item order, the from item before the to item and
+     * the extra nodes after it in ascending order. Images written before transactions were sorted keep the order of
+     * the transactions, which the miner and merge cannot use
+     * \param fromNode The from node
+     * \param toNode The to node
+     * \param extraNodes The extra nodes
+     * \return True if the edge is in the canonical order
+     */
+    [[nodiscard]] bool isCanonicalEdge(ItemId fromNode, ItemId toNode, std::span<const ItemId> extraNodes) const noexcept;
 
     /**
      * \brief Checks if the edge exists, if so, increments the weight
@@ -41,40 +137,246 @@ class Graph
      * \return True if the weight was incremented otherwise false if edge was not
      * found
      */
-    bool incrementIfRawEdgeExists(char fromNode, char toNode, const std::list<char> &extraNodes) noexcept;
+    bool incrementIfRawEdgeExists(ItemId fromNode, ItemId toNode, SuffixId extraNodes) noexcept;
 
     /**
-     * \brief Maps node to an integer postion to use for building CLM
-     * \param node The node to map
-     * \return The position of the node
+     * \brief Adds the cells of an edge to the CLM, the major column of the to node and a minor column per extra node
+     * \param fromNode The from node
+     * \param toNode The to node
+     * \param extraNodes The extra nodes
+     * \param occurrence The weight to add
      */
-    [[nodiscard]] size_t mapNodeToPosition(char node) const noexcept;
-    [[nodiscard]] char mapPostionToNode(size_t node) const noexcept;
+    void addEdgeToClm(ItemId fromNode, ItemId toNode, SuffixId extraNodes, size_t occurrence);
 
-public:
-    NLOHMANN_DEFINE_TYPE_INTRUSIVE(Graph, nodes, edges, CLM);
+    /**
+     * \brief Replaces the CLM with one of a different layout or size, carrying the cells over when they fit
+     * \param layout The new layout
+     * \param maxNodes The new number of items
+     */
+    void reshapeClm(ClmMatrix::Layout layout, size_t maxNodes);
+
+    /**
+     * \brief Processes a transaction of item IDs into the graph generating new nodes and edges
+     * \param items The items of the transaction, these are sorted into the canonical item order and deduplicated
+     */
+    void processItems(std::vector<ItemId> &items);
+
+    /**
+     * \brief Processes newline separated transactions, the items of a transaction are separated by whitespace
+     * \param lines The transactions to process
+     */
+    void processTransactionLines(std::string_view lines);
+
+    /**
+     * \brief Splits a transaction line into its whitespace separated items
+     * \param line The line to split
+     * \param items The items of the line, cleared before the line is split
+     */
+    static void splitItems(std::string_view line, std::vector<std::string_view> &items);
 
+    // The sizes of a partial graph after it processed a chunk of a transaction stream
+    struct ChunkMark {
+      size_t nodes{};
+      size_t suffixes{};
+      size_t edges{};
+    };
+
+    /**
+     * \brief Merges the partial graphs built from the chunks of a transaction stream, giving the same IDs and edge order
+     * as processing the chunks one after another. The new items and suffixes of every chunk are replayed in stream
+     * order, then the edges are summed in parallel by tasks that each own the edges of a share of the from items, so no
+     * edge goes through the edge index. The CLM is not updated
+     * \param partials The partial graphs
+     * \param chunkOwners The partial graph that processed every chunk, in stream order
+     * \param marks The sizes of every partial graph after each of its chunks
+     * \param threads The number of threads summing edges
+     */
+    void mergePartials(const std::vector<Graph> &partials, const std::vector<size_t> &chunkOwners,
+                       const std::vector<std::vector<ChunkMark>> &marks, size_t threads);
+
+    /**
+     * \brief Groups the indices of the edges by their from item with a counting sort
+     * \param rowOffsets Set to the start of every row in rowEdges followed by the number of edges
+     * \param rowEdges Set to the edge indices, the edges of row r are rowEdges[rowOffsets[r], rowOffsets[r + 1])
+     */
+    void groupEdgesByRow(std::vector<size_t> &rowOffsets, std::vector<size_t> &rowEdges) const;
+
+    // Depth-first FI enumeration over a single CLM row, defined in GraphMining.cpp
+    class RowMiner;
+
+    // SAX handler filling a graph from a JSON image, defined in GraphImage.cpp
+    class ImageReader;
+
+    /**
+     * \brief Mines every row of the CLM, making sure the CLM is current first. With more than one thread the rows are
+     * handed to a work-stealing thread pool
+     * \param order The rows in the order they are handed out
+     * \param ranks The position of every item in the canonical order
+     * \param minSupport The minimum support count, it may be raised by the visitors while the rows are mined
+     * \param threads The number of threads mining rows
+     * \param mode Which FIs to report
+     * \param rowVisitor Gives the visitor of the row at a position in order
+     * \param rowMined Called with the position of a row once it is mined, from the thread that mined it
+     */
+    void mineRows(const std::vector<ItemId> &order, const std::vector<uint32_t> &ranks,
+                  const std::atomic<size_t> &minSupport, size_t threads, MiningMode mode,
+                  const std::function<FiVisitor(size_t)> &rowVisitor,
+                  const std::function<void(size_t)> &rowMined = nullptr);
+
+public:
     explicit Graph(const size_t maxNodes): maxNodes(maxNodes) {}
     Graph() = default;
 
-    void setMaxNodes(size_t maxNodes) noexcept;
+    /**
+     * \brief Sets the number of items the CLM has columns for, the CLM grows on its own when more items appear and is
+     * left as it is when it already has at least as many columns
+     * \param maxNodes The number of items
+     */
+    void setMaxNodes(size_t maxNodes);
+
+    /**
+     * \brief Selects the storage layout of the CLM, the cells are carried over into the new layout
+     * \param layout The layout to use, Auto picks the dense layout for small alphabets
+     */
+    void setClmLayout(ClmMatrix::Layout layout);
 
     /**
      * \brief Processes the passed string into the graph generating new nodes and
-     * edges \param str The transaction to process
+     * edges, every UTF-8 character of the string is an item \param str The transaction to process
      */
     void processTransaction(const std::string &str);
 
+    /**
+     * \brief Processes the passed items into the graph generating new nodes and edges
+     * \param items The external tokens of the items of the transaction
+     */
+    void processTransaction(std::span<const std::string_view> items);
+
+    /**
+     * \brief Streams transactions in the FIMI format, one transaction per line with whitespace separated items, into
+     * the graph. With more than one thread the stream is cut into chunks of whole lines that are handed to the workers
+     * round-robin, every worker builds its own partial graph and the partial graphs are merged chunk by chunk in stream
+     * order once the stream is exhausted, so the graph is the same for any thread count. A current CLM is then rebuilt
+     * once from the merged graph on the same number of threads rather than updated edge by edge
+     * \param stream The stream to read the transactions from
+     * \param threads The number of worker threads, 1 processes the transactions on the calling thread
+     */
+    void processTransactions(std::istream &stream, size_t threads = 1);
+
+    /**
+     * \brief Writes the graph as a binary snapshot, the snapshot holds the tokens, nodes, edges and, if it is current,
+     * the CLM as sequential sections so that writing is a single pass over the graph
+     * \param stream The stream to write to, this should be opened in binary mode
+     */
+    void writeSnapshot(std::ostream &stream) const;
+
+    /**
+     * \brief Loads a graph from a binary snapshot written by writeSnapshot, the file is memory mapped and its sections
+     * are copied straight into the graph
+     * \param path The snapshot file
+     * \return The loaded graph
+     * \throws std::runtime_error If the file cannot be mapped or is not a valid snapshot
+     */
+    static Graph loadSnapshot(const std::string &path);
+
+    /**
+     * \brief Loads a graph from a JSON image in a single pass with nlohmann's SAX parser, the nodes and edges go straight
+     * into the graph without building a JSON value first. The CLM of the image is skipped, it is rebuilt when mining
+     * \param stream The stream to read the image from
+     * \return The loaded graph
+     * \throws nlohmann::json::parse_error If the image is not valid JSON
+     * \throws std::runtime_error If the image is not a graph
+     */
+    static Graph loadImage(std::istream &stream);
+
+    /**
+     * \brief Writes the graph as a JSON image, streamed node by node, edge by edge and CLM row by CLM row through a
+     * JsonWriter, so the image is never held in memory. This is the only writer of images, loadImage the only reader.
+     * The CLM is written as it is, callers rebuild it first when it is not current
+     * \param stream The stream to write to
+     */
+    void writeImage(std::ostream &stream) const;
+
+    /**
+     * \brief Adds the node occurrences and edge weights of another graph to this graph, items are matched by token so
+     * the graphs do not need to share item IDs. The CLM is updated with the counts of the other graph
+     * \param other The graph to add
+     */
+    void merge(const Graph &other);
+
+    /**
+     * \brief Rebuilds the CLM from all nodes and edges, mining does this on its own when the CLM is not current. With
+     * more than one thread the edges are grouped by their from item and every row is filled by a single task, so no two
+     * threads ever write to the same row
+     * \param threads The number of threads filling rows
+     */
+    void rebuildClm(size_t threads = 1);
+
+    /**
+     * \brief Checks if the CLM matches the nodes and edges, mining rebuilds it on its own when it does not
+     */
+    [[nodiscard]] bool isClmCurrent() const noexcept;
+
+    /**
+     * \brief Streams the FIs above the minimum support found using the CLM Miner algorithm to a visitor. With one thread
+     * every FI reaches the visitor as soon as it is found, with more each row is held until the rows before it were
+     * handed out so that the FIs come in the same order for any thread count. The visitor is never called concurrently
+     * \param minSup The minimum support count
+     * \param visitor Receives every FI with its support count
+     * \param threads The number of threads mining rows of the CLM
+     * \param mode Whether to report every FI or only the maximal or closed ones
+     */
+    void visitFIs(int minSup, const FiVisitor &visitor, size_t threads = 1, MiningMode mode = MiningMode::All);
+
+    /**
+     * \brief Streams the k most frequent FIs found using the CLM Miner algorithm to a visitor once they are known, see
+     * useTopK_Miner
+     * \param k The number of FIs to find
+     * \param visitor Receives the FIs with their support count, best first
+     * \param minSup The minimum support count
+     * \param threads The number of threads mining rows of the CLM
+     */
+    void visitTopK(size_t k, const FiVisitor &visitor, int minSup = 1, size_t threads = 1);
+
     /**
  * \brief Processes FIs above the minimum support using the CLM Miner algorithm
  * \param minSup The minimum support count
- * \return A list of FIs that have support count above or equal to minSup after using the CLM Miner
+ * \param threads The number of threads mining rows of the CLM, the FIs come out in the same order for any count
+ * \param mode Whether to report every FI or only the maximal or closed ones
+ * \return The FIs that have support count above or equal to minSup after using the CLM Miner with their support counts
  */
-    std::list<std::string> useCLM_Miner(int minSup);
+    FrequentItemsets useCLM_Miner(int minSup, size_t threads = 1, MiningMode mode = MiningMode::All);
+
+    /**
+     * \brief Processes the k most frequent FIs using the CLM Miner algorithm. The best FIs found so far are kept in a
+     * bounded heap and once it is full the support of its worst FI becomes the minimum support of the rest of the
+     * search, which starts from the k-th best support of the single items and pairs in the CLM
+     * \param k The number of FIs to find
+     * \param minSup The minimum support count, no FI below it is reported even if fewer than k are found
+     * \param threads The number of threads mining rows of the CLM
+     * \return The k FIs of the highest support count with their support counts, ordered by support count and then by
+     * the canonical order
+     */
+    FrequentItemsets useTopK_Miner(size_t k, int minSup = 1, size_t threads = 1);
+
+    /**
+     * \brief Joins the tokens of a set of items into the string reported for an FI
+     * \param items The items of the FI
+     * \return The tokens separated by spaces
+     */
+    [[nodiscard]] std::string itemsToString(std::span<const ItemId> items) const;
+
+    /**
+     * \brief Writes an FI as the JSON object {"itemset": the items separated by spaces, "support": its support count}
+     * \param writer The writer to write to
+     * \param items The items of the FI
+     * \param support The support count of the FI
+     */
+    void writeFI(JsonWriter &writer, std::span<const ItemId> items, size_t support) const;
 
     /**
      * \brief Serializes all of the graph data excluding JSON history into a
-     * string \return The resultant string
+     * string, a sparse CLM is listed as its non-zero cells rather than as a matrix \return The resultant string
      */
     [[nodiscard]] std::string toString() const noexcept;
 };
@@ -0,0 +1,81 @@
+#ifndef ITEM_DICTIONARY_H
+#define ITEM_DICTIONARY_H
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+using ItemId = std::uint32_t;
+
+/**
+ * \brief Maps external item tokens to dense 32-bit item IDs and back, IDs are handed out in order of first appearance
+ */
+class ItemDictionary
+{
+    struct TokenHash {
+        using is_transparent = void;
+
+        size_t operator()(const std::string_view token) const noexcept
+        {
+            return std::hash<std::string_view>{}(token);
+        }
+    };
+
+    std::vector<std::string> tokens;
+    std::unordered_map<std::string, ItemId, TokenHash, std::equal_to<>> ids;
+
+public:
+    static constexpr ItemId npos = std::numeric_limits<ItemId>::max();
+
+    /**
+     * \brief Measures the UTF-8 character at the start of a text
+     * \param text The text
+     * \return The length in bytes of the character, 0 if the text does not start with a valid UTF-8 character
+     */
+    [[nodiscard]] static size_t utf8Length(std::string_view text) noexcept;
+
+    /**
+     * \brief Checks if a text is valid UTF-8 as a whole
+     * \param text The text
+     * \return True if the text is valid UTF-8
+     */
+    [[nodiscard]] static bool isUtf8(std::string_view text) noexcept;
+
+    /**
+     * \brief Gets the ID of a token, assigning the next free ID if the token is new. Tokens are kept valid UTF-8 so that
+     * every output can hold them, a byte of the token that is not part of a UTF-8 character is taken as the Latin-1
+     * character of the same value, U+0080 to U+00FF for the bytes from 0x80 on
+     * \param token The external token
+     * \return The ID of the token
+     */
+    ItemId intern(std::string_view token);
+
+    /**
+     * \brief Translates an ID back to its external token
+     * \param id The ID to translate
+     * \return The token of the ID
+     */
+    [[nodiscard]] const std::string &token(ItemId id) const noexcept;
+
+    [[nodiscard]] size_t size() const noexcept;
+
+    /**
+     * \brief The canonical item order, shorter tokens come first and equal lengths compare lexicographically, which
+     * orders numeric FIMI items numerically and single character items alphabetically
+     * \param lhs The first item
+     * \param rhs The second item
+     * \return True if lhs comes before rhs
+     */
+    [[nodiscard]] bool precedes(ItemId lhs, ItemId rhs) const noexcept;
+
+    /**
+     * \brief Lists all IDs in the canonical item order
+     * \return The sorted IDs
+     */
+    [[nodiscard]] std::vector<ItemId> sorted() const;
+};
+
+#endif // ITEM_DICTIONARY_H
@@ -0,0 +1,61 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+/**
+ * \brief Writes JSON to a stream piece by piece through a buffer that is handed to the stream in large blocks, so
+ * documents of any size are written without building them in memory first. The output is the same as dumping the
+ * equivalent nlohmann::json value without indentation
+ */
+class JsonWriter
+{
+    static constexpr size_t blockSize = size_t{1} << 16;
+
+    std::ostream &stream;
+    std::string buffer;
+
+    void flushIfFull();
+
+public:
+    explicit JsonWriter(std::ostream &stream);
+
+    /**
+     * \brief Flushes what is left in the buffer to the stream
+     */
+    ~JsonWriter();
+
+    JsonWriter(const JsonWriter &) = delete;
+    JsonWriter &operator=(const JsonWriter &) = delete;
+
+    /**
+     * \brief Writes characters as they are, used for the punctuation of the document
+     */
+    void raw(char c);
+    void raw(std::string_view str);
+
+    /**
+     * \brief Writes a string as a quoted JSON string
+     */
+    void string(std::string_view str);
+
+    /**
+     * \brief Writes a part of a string without the quotes, escaped like string does
+     * \throws nlohmann::json::type_error If the part is not valid UTF-8
+     */
+    void stringPart(std::string_view part);
+
+    void number(size_t value);
+
+    void null();
+
+    /**
+     * \brief Hands the buffer to the stream
+     */
+    void flush();
+};
+
+#endif // JSON_WRITER_H
@@ -0,0 +1,176 @@
+#ifndef SUFFIX_POOL_H
+#define SUFFIX_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <span>
+#include <vector>
+#include "ItemDictionary.hpp"
+
+using SuffixId = std::uint32_t;
+
+/**
+ * \brief Interns the extra node sequences of edges as a shared suffix trie, every suffix is a node holding its first
+ * item and the ID of the suffix after it, so suffixes sharing a tail share its nodes. The empty suffix always has the
+ * ID empty
+ */
+class SuffixPool
+{
+public:
+    // A trie node, the first item of a suffix and the ID of the suffix after it
+    struct Node {
+      ItemId item{};
+      SuffixId next{};
+    };
+
+    static constexpr SuffixId freeSlot = ~SuffixId{0};
+
+private:
+
+    std::vector<Node> nodes;
+
+    // Open addressing hash of (item, next) -> ID, a power of two in size and at most half full
+    std::vector<SuffixId> slots;
+
+    [[nodiscard]] static size_t hash(ItemId item, SuffixId next) noexcept;
+
+    /**
+     * \brief Doubles the hash table and reinserts every node
+     */
+    void grow();
+
+public:
+    static constexpr SuffixId empty = 0;
+
+    /**
+     * \brief Walks the items of a suffix by following the trie
+     */
+    class Iterator
+    {
+        const SuffixPool *pool = nullptr;
+        SuffixId id = empty;
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = ItemId;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const ItemId *;
+        using reference = const ItemId &;
+
+        Iterator() = default;
+        Iterator(const SuffixPool *pool, const SuffixId id) : pool(pool), id(id) {}
+
+        reference operator*() const noexcept
+        {
+            return pool->nodes[id].item;
+        }
+
+        Iterator &operator++() noexcept
+        {
+            id = pool->nodes[id].next;
+            return *this;
+        }
+
+        Iterator operator++(int) noexcept
+        {
+            Iterator previous = *this;
+            ++*this;
+            return previous;
+        }
+
+        bool operator==(const Iterator &rhs) const noexcept
+        {
+            return id == rhs.id;
+        }
+    };
+
+    /**
+     * \brief The items of a suffix as a range
+     */
+    class Suffix
+    {
+        const SuffixPool *pool;
+        SuffixId id;
+
+    public:
+        Suffix(const SuffixPool *pool, const SuffixId id) : pool(pool), id(id) {}
+
+        [[nodiscard]] Iterator begin() const noexcept
+        {
+            return {pool, id};
+        }
+
+        [[nodiscard]] Iterator end() const noexcept
+        {
+            return {pool, empty};
+        }
+    };
+
+    SuffixPool();
+
+    /**
+     * \brief Gets the ID of the suffix made of an item followed by an existing suffix, adding a trie node if it is new
+     * \param item The first item
+     * \param next The suffix after the item
+     * \return The ID of the suffix
+     * \throws std::length_error If the pool ran out of IDs
+     */
+    SuffixId extend(ItemId item, SuffixId next);
+
+    /**
+     * \brief Gets the ID of a suffix, adding trie nodes for the parts that are new
+     * \param suffix The items of the suffix
+     * \return The ID of the suffix
+     */
+    SuffixId intern(std::span<const ItemId> suffix);
+
+    /**
+     * \brief Gets the items of a suffix
+     * \param id The ID of the suffix
+     * \return The items, valid until the pool is destroyed
+     */
+    [[nodiscard]] Suffix get(SuffixId id) const noexcept;
+
+    /**
+     * \brief Gets the first item of a suffix
+     * \param id The ID of a suffix that is not empty
+     */
+    [[nodiscard]] ItemId head(const SuffixId id) const noexcept
+    {
+        return nodes[id].item;
+    }
+
+    /**
+     * \brief Gets the suffix after the first item of a suffix
+     * \param id The ID of a suffix that is not empty
+     */
+    [[nodiscard]] SuffixId tail(const SuffixId id) const noexcept
+    {
+        return nodes[id].next;
+    }
+
+    [[nodiscard]] size_t size() const noexcept;
+
+    /**
+     * \brief Gets the trie nodes indexed by suffix ID
+     */
+    [[nodiscard]] std::span<const Node> getNodes() const noexcept;
+
+    /**
+     * \brief Gets the open addressing hash of the trie nodes, freeSlot marks an unused slot
+     */
+    [[nodiscard]] std::span<const SuffixId> getSlots() const noexcept;
+
+    /**
+     * \brief Replaces the pool with trie nodes and a hash written from getNodes and getSlots, so a pool can be restored
+     * without interning its suffixes again
+     * \param nodes The trie nodes
+     * \param slots The hash of the trie nodes
+     * \param itemCount The number of items, every item of a node must be below it
+     * \throws std::invalid_argument If the nodes and slots do not form a pool
+     */
+    void assign(std::span<const Node> nodes, std::span<const SuffixId> slots, size_t itemCount);
+};
+
+#endif // SUFFIX_POOL_H
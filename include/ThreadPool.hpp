@@ -0,0 +1,80 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * \brief A fixed set of worker threads with a task queue each, tasks are handed to the queues round-robin and a worker
+ * whose queue runs dry steals from the front of the other queues, which keeps the workers busy when tasks are uneven
+ */
+class ThreadPool
+{
+    struct Queue {
+      std::mutex mutex;
+      std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues; // One per worker
+    std::vector<std::jthread> workers;
+
+    // Guards the counters below, never held together with the mutex of a queue
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    size_t queued = 0; // Tasks waiting in a queue
+    size_t unfinished = 0; // Tasks submitted but not yet finished
+    size_t nextQueue = 0;
+    bool stopping = false;
+    std::exception_ptr failure; // The first exception thrown by a task
+
+    /**
+     * \brief Takes a task, the newest of the own queue or else the oldest of another queue
+     * \param self The index of the worker
+     * \param task The task taken
+     * \return False if every queue is empty
+     */
+    bool take(size_t self, std::function<void()> &task);
+
+    /**
+     * \brief Runs tasks until the pool is destroyed
+     * \param self The index of the worker
+     */
+    void work(size_t self);
+
+public:
+    /**
+     * \brief Starts the workers
+     * \param threads The number of workers, at least one is started
+     */
+    explicit ThreadPool(size_t threads);
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /**
+     * \brief Finishes the queued tasks and joins the workers
+     */
+    ~ThreadPool();
+
+    /**
+     * \brief Queues a task to be run by one of the workers
+     * \param task The task to run
+     */
+    void submit(std::function<void()> task);
+
+    /**
+     * \brief Blocks until every submitted task has finished
+     * \throws The first exception thrown by a task since the last wait
+     */
+    void wait();
+};
+
+#endif // THREAD_POOL_H
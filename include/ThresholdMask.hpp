@@ -0,0 +1,43 @@
+#ifndef THRESHOLD_MASK_H
+#define THRESHOLD_MASK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+/**
+ * \brief A bitmask of the cells of a CLM row whose count reaches a threshold, the scan compares whole blocks of cells
+ * with AVX-512 or AVX2 when the CPU supports them and falls back to a scalar loop otherwise
+ */
+class ThresholdMask
+{
+    std::vector<uint64_t> words;
+
+public:
+    /**
+     * \brief Replaces the mask with the cells that are at least the threshold, there is an overload per cell width
+     * \param cells The cells to scan
+     * \param threshold The minimum count of a cell
+     */
+    void scan(std::span<const uint16_t> cells, size_t threshold);
+    void scan(std::span<const uint32_t> cells, size_t threshold);
+    void scan(std::span<const uint64_t> cells, size_t threshold);
+
+    /**
+     * \brief Checks if a cell passed the last scan
+     * \param cell The index of the cell
+     */
+    [[nodiscard]] bool test(const size_t cell) const noexcept
+    {
+        return (words[cell / 64] >> (cell % 64) & 1) != 0;
+    }
+
+    /**
+     * \brief Gets the name of the kernel selected for this CPU
+     * \return "avx512", "avx2" or "scalar"
+     */
+    [[nodiscard]] static const char *kernel() noexcept;
+};
+
+#endif // THRESHOLD_MASK_H
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 
@@ -44,8 +45,30 @@ int main(int argc, char **argv)
         return 3;
     }
 
+    // Check for a valid top k, the min support is optional when it is used
+    size_t topK = 0;
+    if (arguments.contains("-top-k"))
+    {
+        try
+        {
+            const int parsed = std::stoi(arguments["-top-k"]);
+
+            if (parsed < 1)
+            {
+                throw std::exception();
+            }
+            topK = parsed;
+        } catch (std::exception& _)
+        {
+            std::cout << "Top K is not a valid number!\n";
+            std::cout << _.what();
+
+            return 14;
+        }
+    }
+
     // Check for valid min support
-    int minSupport;
+    int minSupport = 1;
     if (arguments.contains("-min-support"))
     {
         try
@@ -64,37 +87,96 @@ int main(int argc, char **argv)
 
             return 4;
         }
-    } else
+    } else if (topK == 0)
     {
         std::cout << "Min support is not provided!\n";
         return 5;
     }
 
     // Check for valid transactions
-    if (!arguments.contains("-transactions"))
+    if (!arguments.contains("-transactions") && !arguments.contains("-transactions-file") &&
+        !arguments.contains("-image") && !arguments.contains("-snapshot") && !arguments.contains("-merge-images"))
     {
         std::cout << "No transactions provided!\n";
         return 6;
     }
-    std::vector<std::string> transactions;
-    const std::string transactions_str = arguments["-transactions"];
-    for (size_t offset = 0; offset < transactions_str.length();)
+
+    // Check that the graph is set up from at most one of an image and a snapshot
+    if (arguments.contains("-image") && arguments.contains("-snapshot"))
     {
-        const size_t pos = transactions_str.find_first_of(' ', offset);
+        std::cout << "Only one of image and snapshot can be used!\n";
+        return 1;
+    }
 
-        std::string temp;
-        for (size_t i = offset; i < pos && i < transactions_str.length(); ++i)
+    // Check for a valid number of threads
+    size_t threads = 1;
+    if (arguments.contains("-threads"))
+    {
+        try
         {
-            temp += transactions_str[i];
+            const int parsed = std::stoi(arguments["-threads"]);
+
+            if (parsed < 1)
+            {
+                throw std::exception();
+            }
+            threads = parsed;
+        } catch (std::exception& _)
+        {
+            std::cout << "Threads is not a valid number!\n";
+            std::cout << _.what();
+
+            return 9;
         }
+    }
 
+    // Check for a valid CLM layout
+    ClmMatrix::Layout clmLayout = ClmMatrix::Layout::Auto;
+    if (arguments.contains("-clm-layout"))
+    {
+        const std::map<std::string, ClmMatrix::Layout> layouts{
+            {"auto", ClmMatrix::Layout::Auto}, {"dense", ClmMatrix::Layout::Dense}, {"sparse", ClmMatrix::Layout::Sparse}};
 
-        transactions.push_back(temp);
+        const auto it = layouts.find(arguments["-clm-layout"]);
+        if (it == layouts.end())
+        {
+            std::cout << "CLM layout must be one of auto, dense or sparse!\n";
+            return 8;
+        }
+        clmLayout = it->second;
+    }
 
-        if (pos == std::string::npos) break;
-        offset = pos + 1;
+    // Check for a valid mining mode
+    Graph::MiningMode miningMode = Graph::MiningMode::All;
+    if (arguments.contains("-mode"))
+    {
+        const std::map<std::string, Graph::MiningMode> modes{
+            {"all", Graph::MiningMode::All}, {"maximal", Graph::MiningMode::Maximal},
+            {"closed", Graph::MiningMode::Closed}};
+
+        const auto it = modes.find(arguments["-mode"]);
+        if (it == modes.end())
+        {
+            std::cout << "Mode must be one of all, maximal or closed!\n";
+            return 13;
+        }
+        miningMode = it->second;
+    }
+    if (topK > 0 && miningMode != Graph::MiningMode::All)
+    {
+        std::cout << "Top K can only be used with the all mode!\n";
+        return 1;
     }
 
+    // Streams the FIs of the requested mode to a visitor
+    const auto mine = [&](Graph& graph, const Graph::FiVisitor& visitor)
+    {
+        if (topK > 0)
+            graph.visitTopK(topK, visitor, minSupport, threads);
+        else
+            graph.visitFIs(minSupport, visitor, threads, miningMode);
+    };
+
     // Create the graph
     Graph graph(maxNodes);
 
@@ -102,33 +184,126 @@ int main(int argc, char **argv)
     if (arguments.contains("-image"))
     {
         std::cout << "Image file specified, setting up graph from image!\n";
-        std::fstream fstream(arguments["-image"]);
+        std::ifstream fstream(arguments["-image"], std::ios::binary);
         if (!fstream.is_open())
         {
             std::cout << "Failed to read image file!";
             return 30;
         }
-        graph = nlohmann::json::parse(fstream).get<Graph>();
+
+        try
+        {
+            graph = Graph::loadImage(fstream);
+        } catch (std::exception& _)
+        {
+            std::cout << "Failed to read image file!\n";
+            std::cout << _.what();
+
+            return 30;
+        }
+        graph.setMaxNodes(maxNodes);
+    }
+
+    // Set up graph from a binary snapshot if specified (32 - Failed Snapshot Read)
+    if (arguments.contains("-snapshot"))
+    {
+        std::cout << "Snapshot file specified, setting up graph from snapshot!\n";
+        try
+        {
+            graph = Graph::loadSnapshot(arguments["-snapshot"]);
+        } catch (std::exception& _)
+        {
+            std::cout << "Failed to read snapshot file!\n";
+            std::cout << _.what();
+
+            return 32;
+        }
         graph.setMaxNodes(maxNodes);
     }
 
-    // Process all transactions
-    for (const std::string &transaction : transactions)
+    // Merge every image file into the graph if specified, these are separated by spaces (31 - Failed Merge Image Read)
+    if (arguments.contains("-merge-images"))
     {
-        graph.processTransaction(transaction);
+        const std::string &images_str = arguments["-merge-images"];
+        for (size_t offset = 0; offset < images_str.length();)
+        {
+            const size_t pos = std::min(images_str.find_first_of(' ', offset), images_str.length());
+
+            if (pos > offset)
+            {
+                const std::string image = images_str.substr(offset, pos - offset);
+                std::cout << "Merging image " << image << " into the graph!\n";
+
+                std::ifstream fstream(image, std::ios::binary);
+                if (!fstream.is_open())
+                {
+                    std::cout << "Failed to read merge image file!\n";
+                    return 31;
+                }
+
+                try
+                {
+                    graph.merge(Graph::loadImage(fstream));
+                } catch (std::exception& _)
+                {
+                    std::cout << "Failed to read merge image file!\n";
+                    std::cout << _.what();
+
+                    return 31;
+                }
+            }
+
+            offset = pos + 1;
+        }
+    }
+    graph.setClmLayout(clmLayout);
+
+    // Process all transactions passed as an argument, these are separated by spaces and every UTF-8 character is an
+    // item
+    if (arguments.contains("-transactions"))
+    {
+        const std::string &transactions_str = arguments["-transactions"];
+        for (size_t offset = 0; offset < transactions_str.length();)
+        {
+            const size_t pos = std::min(transactions_str.find_first_of(' ', offset), transactions_str.length());
+
+            if (pos > offset)
+            {
+                graph.processTransaction(transactions_str.substr(offset, pos - offset));
+            }
+
+            offset = pos + 1;
+        }
+    }
+
+    // Stream all transactions from a file, one transaction per line (7 - Failed Transactions File Read)
+    if (arguments.contains("-transactions-file"))
+    {
+        std::ifstream fstream(arguments["-transactions-file"], std::ios::binary);
+        if (!fstream.is_open())
+        {
+            std::cout << "Failed to read transactions file!\n";
+            return 7;
+        }
+
+        graph.processTransactions(fstream, threads);
     }
 
     // Output to Console if no output files specified
     if (!(arguments.contains("-output") && arguments.contains("-fis-output")))
     {
-        const auto& FIs = graph.useCLM_Miner(minSupport);
+        // The CLM is printed with the graph, so it has to be current before the FIs start streaming
+        if (!graph.isClmCurrent())
+        {
+            graph.rebuildClm(threads);
+        }
         std::cout << graph.toString();
 
         std::cout << "FIs:\n";
-        for (const auto& FI : FIs)
+        mine(graph, [&graph](const std::span<const ItemId> items, size_t)
         {
-            std::cout << '\t' << FI << '\n';
-        }
+            std::cout << '\t' << graph.itemsToString(items) << '\n';
+        });
     }
 
     // Output graph as JSON to JSON file (10 - Bad file, 11 - Failed Output)
@@ -147,15 +322,40 @@ int main(int argc, char **argv)
             return 11;
         }
 
-        fstream << nlohmann::json(graph);
+        // Images hold the CLM, which is only left stale when the console output did not rebuild it
+        if (!graph.isClmCurrent())
+        {
+            graph.rebuildClm(threads);
+        }
+        graph.writeImage(fstream);
+        fstream.flush();
+        fstream.close();
+    }
+
+    // Output graph as a binary snapshot (12 - Failed Output)
+    if (arguments.contains("-snapshot-output"))
+    {
+        std::ofstream fstream(arguments["-snapshot-output"], std::ios::binary);
+        if (!fstream.is_open())
+        {
+            std::cout << "Failed snapshot output!\n";
+            return 12;
+        }
+
+        graph.writeSnapshot(fstream);
         fstream.flush();
+        if (!fstream)
+        {
+            std::cout << "Failed snapshot output!\n";
+            return 12;
+        }
         fstream.close();
     }
 
     // Output FIs to a JSON file (20 - Bad file, 21 - Failed Output)
     if (arguments.contains("-fis-output"))
     {
-        if (!arguments["-image"].ends_with(".json"))
+        if (!arguments["-fis-output"].ends_with(".json"))
         {
             std::cout << "Bad FIs output file!\n";
             return 20;
@@ -168,7 +368,21 @@ int main(int argc, char **argv)
             return 21;
         }
 
-        fstream << nlohmann::json(graph.useCLM_Miner(minSupport));
+        // The FIs are written as a JSON array of itemsets with their support counts while they are found
+        JsonWriter writer(fstream);
+        bool first = true;
+        writer.raw('[');
+        mine(graph, [&](const std::span<const ItemId> items, const size_t support)
+        {
+            if (!first)
+            {
+                writer.raw(',');
+            }
+            graph.writeFI(writer, items, support);
+            first = false;
+        });
+        writer.raw(']');
+        writer.flush();
         fstream.flush();
         fstream.close();
     }
@@ -0,0 +1,291 @@
+#include "../include/ClmMatrix.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+// PRIVATE FUNCTIONS
+
+size_t ClmMatrix::denseIndex(const ItemId major, const ItemId minor) const noexcept
+{
+    return major * (maxNodes + 1) + (minor == majorCell ? 0 : minor + 1);
+}
+
+uint64_t ClmMatrix::sparseKey(const ItemId major, const ItemId minor) noexcept
+{
+    return static_cast<uint64_t>(major) << 32 | static_cast<uint32_t>(minor + 1);
+}
+
+template <typename T>
+void ClmMatrix::resizeDenseCells()
+{
+    constexpr size_t cellsPerLine = cacheLine / sizeof(T);
+    const size_t stride = (rowSize + cellsPerLine - 1) / cellsPerLine * cellsPerLine;
+
+    DenseCells<T> resized(maxNodes * stride, 0);
+    std::visit([&](const auto &cells)
+    {
+        for (size_t row = 0; row < rows.size(); ++row)
+        {
+            if (rows[row])
+            {
+                std::copy_n(cells.data() + row * rowStride, rowSize, resized.data() + row * stride);
+            }
+        }
+    }, denseCells);
+
+    rowStride = stride;
+    denseCells = std::move(resized);
+}
+
+void ClmMatrix::widenDenseCells()
+{
+    if (std::holds_alternative<DenseCells<uint16_t>>(denseCells))
+        resizeDenseCells<uint32_t>();
+    else
+        resizeDenseCells<uint64_t>();
+}
+
+
+// PUBLIC FUNCTIONS
+
+ClmMatrix::ClmMatrix(const Layout layout, const size_t maxNodes) :
+    layout(layout), maxNodes(maxNodes), rowSize(maxNodes * maxNodes + maxNodes)
+{
+    if (layout == Layout::Auto)
+    {
+        this->layout = maxNodes <= denseLimit ? Layout::Dense : Layout::Sparse;
+    }
+
+    // Dense rows can only belong to the first maxNodes items, so the whole matrix is allocated up front
+    if (this->layout == Layout::Dense)
+    {
+        resizeDenseCells<uint16_t>();
+        rows.assign(maxNodes, false);
+    }
+}
+
+ClmMatrix::Layout ClmMatrix::getLayout() const noexcept
+{
+    return layout;
+}
+
+void ClmMatrix::ensureRow(const ItemId row)
+{
+    if (row >= rows.size())
+    {
+        if (layout != Layout::Sparse)
+        {
+            throw std::out_of_range("Dense CLM row out of range");
+        }
+
+        rows.resize(row + 1, false);
+        sparseRows.resize(row + 1);
+    }
+
+    // Existing rows are only read, which lets adds to different rows run concurrently
+    if (!rows[row])
+    {
+        rows[row] = true;
+    }
+}
+
+void ClmMatrix::reserveCount(const size_t count)
+{
+    while (layout != Layout::Sparse && std::visit([count](const auto &cells)
+    {
+        return count > std::numeric_limits<typename std::decay_t<decltype(cells)>::value_type>::max();
+    }, denseCells))
+    {
+        widenDenseCells();
+    }
+}
+
+bool ClmMatrix::hasRow(const ItemId row) const noexcept
+{
+    return row < rows.size() && rows[row];
+}
+
+bool ClmMatrix::scanRow(const ItemId row, const size_t threshold, ThresholdMask &mask) const
+{
+    if (layout == Layout::Sparse || !hasRow(row))
+        return false;
+
+    std::visit([&](const auto &cells)
+    {
+        mask.scan(std::span(cells.data() + row * rowStride, rowSize), threshold);
+    }, denseCells);
+
+    return true;
+}
+
+size_t ClmMatrix::getCellBytes() const noexcept
+{
+    return std::visit([](const auto &cells) { return sizeof(cells[0]); }, denseCells);
+}
+
+std::span<const char> ClmMatrix::denseBytes() const noexcept
+{
+    if (layout == Layout::Sparse)
+        return {};
+
+    return std::visit([](const auto &cells)
+    {
+        return std::span(reinterpret_cast<const char *>(cells.data()), cells.size() * sizeof(cells[0]));
+    }, denseCells);
+}
+
+ClmMatrix ClmMatrix::fromDenseBytes(const size_t maxNodes, const size_t cellBytes, const std::span<const char> bytes)
+{
+    if (cellBytes != 2 && cellBytes != 4 && cellBytes != 8)
+    {
+        throw std::invalid_argument("Dense CLM cells must be 2, 4 or 8 bytes");
+    }
+
+    // Every row holds more than maxNodes squared cells, bounding maxNodes by the bytes first keeps the sizes below from
+    // overflowing
+    const size_t cells = bytes.size() / cellBytes;
+    if (maxNodes == 0 || maxNodes > cells / maxNodes)
+    {
+        throw std::invalid_argument("Dense CLM bytes do not match its number of items");
+    }
+
+    const size_t cellsPerLine = cacheLine / cellBytes;
+    const size_t rowSize = maxNodes * maxNodes + maxNodes;
+    const size_t stride = (rowSize + cellsPerLine - 1) / cellsPerLine * cellsPerLine;
+    if (bytes.size() % cellBytes != 0 || stride > cells / maxNodes || maxNodes * stride != cells)
+    {
+        throw std::invalid_argument("Dense CLM bytes do not match its number of items");
+    }
+
+    // The sparse layout allocates nothing up front, the matrix becomes dense once the cells are in place
+    ClmMatrix matrix(Layout::Sparse, maxNodes);
+    matrix.layout = Layout::Dense;
+    matrix.rowStride = stride;
+    matrix.rows.assign(maxNodes, false);
+
+    const auto adopt = [&]<typename T>(DenseCells<T> adopted)
+    {
+        std::memcpy(adopted.data(), bytes.data(), bytes.size());
+        matrix.denseCells = std::move(adopted);
+    };
+    if (cellBytes == 2)
+        adopt(DenseCells<uint16_t>(cells));
+    else if (cellBytes == 4)
+        adopt(DenseCells<uint32_t>(cells));
+    else
+        adopt(DenseCells<uint64_t>(cells));
+
+    return matrix;
+}
+
+size_t ClmMatrix::sparseRowSize(const ItemId row) const noexcept
+{
+    if (layout != Layout::Sparse || !hasRow(row))
+        return 0;
+
+    return sparseRows[row].size();
+}
+
+void ClmMatrix::sparseRowCells(const ItemId row, std::vector<SparseCell> &cells) const
+{
+    cells.clear();
+    if (layout != Layout::Sparse || !hasRow(row))
+        return;
+
+    cells.reserve(sparseRows[row].size());
+    for (const auto &[key, count] : sparseRows[row])
+    {
+        cells.push_back({key, count});
+    }
+    std::ranges::sort(cells, {}, &SparseCell::key);
+}
+
+void ClmMatrix::assignSparseRow(const ItemId row, const std::span<const SparseCell> cells, const size_t items)
+{
+    if (layout != Layout::Sparse)
+    {
+        throw std::invalid_argument("Only sparse CLM rows can be assigned");
+    }
+
+    ensureRow(row);
+    std::unordered_map<uint64_t, size_t> &sparseRow = sparseRows[row];
+    sparseRow.clear();
+    sparseRow.reserve(cells.size());
+    for (const auto &[key, count] : cells)
+    {
+        // The minor is shifted by one, 0 being the major cell
+        if (count == 0 || (key >> 32) >= items || (key & 0xFFFFFFFF) > items || !sparseRow.emplace(key, count).second)
+        {
+            throw std::invalid_argument("Sparse CLM row has an invalid cell");
+        }
+    }
+}
+
+size_t ClmMatrix::get(const ItemId row, const ItemId major, const ItemId minor) const noexcept
+{
+    if (!hasRow(row))
+        return 0;
+
+    if (layout == Layout::Sparse)
+    {
+        const auto it = sparseRows[row].find(sparseKey(major, minor));
+        return it == sparseRows[row].end() ? 0 : it->second;
+    }
+
+    const size_t index = row * rowStride + denseIndex(major, minor);
+    return std::visit([index](const auto &cells) { return static_cast<size_t>(cells[index]); }, denseCells);
+}
+
+void ClmMatrix::set(const ItemId row, const ItemId major, const ItemId minor, const size_t count)
+{
+    ensureRow(row);
+
+    if (layout == Layout::Sparse)
+    {
+        if (count == 0)
+            sparseRows[row].erase(sparseKey(major, minor));
+        else
+            sparseRows[row][sparseKey(major, minor)] = count;
+        return;
+    }
+
+    const size_t index = row * rowStride + denseIndex(major, minor);
+    while (!std::visit([index, count]<typename T>(DenseCells<T> &cells)
+    {
+        if (count > std::numeric_limits<T>::max())
+            return false;
+
+        cells[index] = static_cast<T>(count);
+        return true;
+    }, denseCells))
+    {
+        widenDenseCells();
+    }
+}
+
+void ClmMatrix::add(const ItemId row, const ItemId major, const ItemId minor, const size_t count)
+{
+    ensureRow(row);
+
+    if (layout == Layout::Sparse)
+    {
+        sparseRows[row][sparseKey(major, minor)] += count;
+        return;
+    }
+
+    // Counts wrap at 64 bits like a size_t would, narrower cells are promoted before they overflow
+    const size_t index = row * rowStride + denseIndex(major, minor);
+    while (!std::visit([index, count]<typename T>(DenseCells<T> &cells)
+    {
+        if (sizeof(T) < sizeof(size_t) && count > static_cast<size_t>(std::numeric_limits<T>::max() - cells[index]))
+            return false;
+
+        cells[index] = static_cast<T>(cells[index] + count);
+        return true;
+    }, denseCells))
+    {
+        widenDenseCells();
+    }
+}
@@ -0,0 +1,10 @@
+#include "../include/FrequentItemsets.hpp"
+
+// PUBLIC FUNCTIONS
+
+void FrequentItemsets::add(const std::span<const ItemId> items, const size_t support)
+{
+    itemBuffer.insert(itemBuffer.end(), items.begin(), items.end());
+    offsets.push_back(itemBuffer.size());
+    supports.push_back(support);
+}
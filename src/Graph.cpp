@@ -1,250 +1,882 @@
 #include "../include/Graph.hpp"
+#include "../include/ThreadPool.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+
+namespace
+{
+    // Transaction files are read in blocks of about this many bytes, cut at the last complete line
+    constexpr size_t chunkSize = 1 << 20;
+
+    // Chunks waiting for a worker, bounded so that reading never runs far ahead of the workers
+    class ChunkQueue
+    {
+        static constexpr size_t capacity = 4;
+
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::deque<std::string> chunks;
+        bool closed = false;
+
+    public:
+        void push(std::string chunk)
+        {
+            std::unique_lock lock(mutex);
+            changed.wait(lock, [this] { return chunks.size() < capacity; });
+            chunks.push_back(std::move(chunk));
+            changed.notify_all();
+        }
+
+        bool pop(std::string &chunk)
+        {
+            std::unique_lock lock(mutex);
+            changed.wait(lock, [this] { return !chunks.empty() || closed; });
+            if (chunks.empty())
+            {
+                return false;
+            }
+
+            chunk = std::move(chunks.front());
+            chunks.pop_front();
+            changed.notify_all();
+            return true;
+        }
+
+        void close()
+        {
+            std::lock_guard lock(mutex);
+            closed = true;
+            changed.notify_all();
+        }
+    };
+}
 
 // PRIVATE FUNCTIONS
 
-bool Graph::incrementIfRawEdgeExists(const char fromNode, const char toNode, const std::list<char> &extraNodes) noexcept
+size_t Graph::hashEdge(const ItemId fromNode, const ItemId toNode, const SuffixId extraNodes) noexcept
 {
-    for (auto &[existingFromNode, existingToNode, existingExtraNodes, existingWeight] : edges)
+    // FNV-1a over the IDs of the triple
+    size_t hash = 14695981039346656037ULL;
+    for (const uint32_t id : {fromNode, toNode, extraNodes})
     {
-        if (existingFromNode == fromNode && existingToNode == toNode && existingExtraNodes == extraNodes)
+        hash ^= id;
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+size_t Graph::findEdge(const ItemId fromNode, const ItemId toNode, const SuffixId extraNodes) const noexcept
+{
+    auto [it, end] = edgeIndex.equal_range(hashEdge(fromNode, toNode, extraNodes));
+    for (; it != end; ++it)
+    {
+        const Edge &edge = edges[it->second];
+        if (edge.from == fromNode && edge.to == toNode && edge.extraNodes == extraNodes)
         {
-            ++existingWeight;
-            return true;
+            return it->second;
         }
     }
+
+    return noEdge;
+}
+
+void Graph::addEdge(const ItemId fromNode, const ItemId toNode, const SuffixId extraNodes, const size_t occurrence)
+{
+    edgeIndex.emplace(hashEdge(fromNode, toNode, extraNodes), edges.size());
+    edges.emplace_back(fromNode, toNode, extraNodes, 0);
+    addEdgeWeight(edges.size() - 1, occurrence);
+}
+
+size_t Graph::edgeWeight(const size_t edge) const noexcept
+{
+    return edges[edge].occurrence == wideOccurrence ? wideEdgeWeights.at(edge) : edges[edge].occurrence;
+}
+
+void Graph::addEdgeWeight(const size_t edge, const size_t occurrence)
+{
+    uint32_t &narrow = edges[edge].occurrence;
+    if (narrow != wideOccurrence && occurrence < static_cast<size_t>(wideOccurrence - narrow))
+    {
+        narrow += static_cast<uint32_t>(occurrence);
+        return;
+    }
+
+    // The weight outgrew 32 bits, keep it in the side table from now on
+    if (narrow != wideOccurrence)
+    {
+        wideEdgeWeights[edge] = narrow;
+        narrow = wideOccurrence;
+    }
+    wideEdgeWeights[edge] += occurrence;
+}
+
+void Graph::groupEdgesByRow(std::vector<size_t> &rowOffsets, std::vector<size_t> &rowEdges) const
+{
+    rowOffsets.assign(nodes.size() + 1, 0);
+    for (const Edge &edge : edges)
+    {
+        ++rowOffsets[edge.from + 1];
+    }
+    for (size_t row = 0; row < nodes.size(); ++row)
+    {
+        rowOffsets[row + 1] += rowOffsets[row];
+    }
+
+    rowEdges.resize(edges.size());
+    std::vector<size_t> next(rowOffsets.begin(), rowOffsets.end() - 1);
+    for (size_t i = 0; i < edges.size(); ++i)
+    {
+        rowEdges[next[edges[i].from]++] = i;
+    }
+}
+
+void Graph::ensureEdgeIndex()
+{
+    if (edgeIndexCurrent)
+        return;
+
+    edgeIndexCurrent = true;
+    edgeIndex.clear();
+    edgeIndex.reserve(edges.size());
+    for (size_t i = 0; i < edges.size(); ++i)
+    {
+        edgeIndex.emplace(hashEdge(edges[i].from, edges[i].to, edges[i].extraNodes), i);
+    }
+}
+
+ItemId Graph::internItem(const std::string_view token)
+{
+    const ItemId id = dictionary.intern(token);
+    if (id == nodes.size())
+    {
+        nodes.emplace_back(id, 0);
+    }
+
+    return id;
+}
+
+bool Graph::isCanonicalEdge(const ItemId fromNode, const ItemId toNode,
+                            const std::span<const ItemId> extraNodes) const noexcept
+{
+    if (!dictionary.precedes(fromNode, toNode))
+        return false;
+
+    ItemId previous = toNode;
+    for (const ItemId extraNode : extraNodes)
+    {
+        if (!dictionary.precedes(previous, extraNode))
+            return false;
+        previous = extraNode;
+    }
+
+    return true;
+}
+
+bool Graph::incrementIfRawEdgeExists(const ItemId fromNode, const ItemId toNode, const SuffixId extraNodes) noexcept
+{
+    if (const size_t edge = findEdge(fromNode, toNode, extraNodes); edge != noEdge)
+    {
+        addEdgeWeight(edge, 1);
+        return true;
+    }
     return false;
 }
 
-size_t Graph::mapNodeToPosition(const char node) const noexcept
+void Graph::processItems(std::vector<ItemId> &items)
 {
-    int i = 0;
-    for (auto it = nodes.cbegin(); it != nodes.cend(); ++i, ++it)
+    // Put the items in the canonical order so that every transaction containing an itemset produces the same edges
+    std::sort(items.begin(), items.end(),
+              [this](const ItemId lhs, const ItemId rhs) { return dictionary.precedes(lhs, rhs); });
+    items.erase(std::unique(items.begin(), items.end()), items.end());
+    ensureEdgeIndex();
+
+    // New items may not fit the CLM anymore, grow it geometrically so that growing stays cheap
+    if (nodes.size() > maxNodes)
     {
-        if (node == it->label)
+        setMaxNodes(std::max(nodes.size(), 2 * maxNodes));
+    }
+
+    // Process nodes
+    for (const ItemId it : items)
+    {
+        nodes[it].occurrence++;
+
+        if (clmCurrent)
+        {
+            CLM.add(it, it, ClmMatrix::majorCell, 1);
+        }
+    }
+
+    // The extra nodes of an edge only depend on where its to node is, walking back from the end every suffix is the
+    // next item in front of the suffix after it, so each one costs a single trie step
+    std::vector<SuffixId> suffixIds(items.size(), SuffixPool::empty);
+    for (size_t offsetIndex = items.size(); offsetIndex-- > 1;)
+    {
+        if (offsetIndex + 1 < items.size())
         {
-            return i;
+            suffixIds[offsetIndex] = suffixes.extend(items[offsetIndex + 1], suffixIds[offsetIndex + 1]);
+        }
+    }
+
+    // Process edges
+    for (size_t startIndex = 0; startIndex + 1 < items.size(); startIndex++)
+    {
+        const ItemId fromNode = items[startIndex];
+
+        for (size_t offsetIndex = startIndex + 1; offsetIndex < items.size(); ++offsetIndex)
+        {
+            const ItemId toNode = items[offsetIndex];
+            const SuffixId extraNodes = suffixIds[offsetIndex];
+
+            if (clmCurrent)
+            {
+                addEdgeToClm(fromNode, toNode, extraNodes, 1);
+            }
+
+            if (!incrementIfRawEdgeExists(fromNode, toNode, extraNodes))
+            {
+                addEdge(fromNode, toNode, extraNodes, 1);
+            }
         }
     }
+}
 
-    return -1;
+void Graph::addEdgeToClm(const ItemId fromNode, const ItemId toNode, const SuffixId extraNodes,
+                         const size_t occurrence)
+{
+    CLM.add(fromNode, toNode, ClmMatrix::majorCell, occurrence);
+
+    for (const ItemId extraNode : suffixes.get(extraNodes))
+    {
+        CLM.add(fromNode, toNode, extraNode, occurrence);
+    }
 }
 
-char Graph::mapPostionToNode(const size_t node) const noexcept
+void Graph::rebuildClm(const size_t threads)
 {
-    auto it = nodes.cbegin();
-    for (int i = 0; it != nodes.cend(); ++i, ++it)
+    // Set up CLM
+    maxNodes = std::max(maxNodes, nodes.size());
+    CLM = ClmMatrix(clmLayout, maxNodes);
+
+    // Fill CLM
+    // Update the individual nodes, this also creates every row
+    for (const auto &[label, occurrence] : nodes)
     {
-        if (node == i)
+        CLM.set(label, label, ClmMatrix::majorCell, occurrence);
+    }
+
+    // Update using edges
+    if (threads <= 1)
+    {
+        for (size_t i = 0; i < edges.size(); ++i)
         {
-            return it->label;
+            addEdgeToClm(edges[i].from, edges[i].to, edges[i].extraNodes, edgeWeight(i));
         }
+
+        clmCurrent = true;
+        return;
     }
 
-    return -1;
-}
+    // Every row is filled by a single task, so no two threads ever write to the same cells
+    std::vector<size_t> rowOffsets;
+    std::vector<size_t> rowEdges;
+    groupEdgesByRow(rowOffsets, rowEdges);
+
+    // The largest cell of a row is its node or the major cell of one of its to items, as every minor cell counts a
+    // share of the edges of its major cell. Widening the cells for exactly that up front means no cell is promoted while
+    // the rows are filled, and the cells end up as wide as filling them one edge at a time makes them
+    size_t largestCount = 0;
+    std::vector<size_t> majorCounts(nodes.size(), 0);
+    for (size_t row = 0; row < nodes.size(); ++row)
+    {
+        largestCount = std::max(largestCount, nodes[row].occurrence);
+        for (size_t i = rowOffsets[row]; i < rowOffsets[row + 1]; ++i)
+        {
+            size_t &count = majorCounts[edges[rowEdges[i]].to];
+            count += edgeWeight(rowEdges[i]);
+            largestCount = std::max(largestCount, count);
+        }
+        for (size_t i = rowOffsets[row]; i < rowOffsets[row + 1]; ++i)
+        {
+            majorCounts[edges[rowEdges[i]].to] = 0;
+        }
+    }
+    CLM.reserveCount(largestCount);
 
+    ThreadPool pool(threads);
+    for (size_t row = 0; row < nodes.size(); ++row)
+    {
+        if (rowOffsets[row] == rowOffsets[row + 1])
+            continue;
 
-// PUBLIC FUNCTIONS
+        pool.submit([this, row, &rowOffsets, &rowEdges]
+        {
+            for (size_t i = rowOffsets[row]; i < rowOffsets[row + 1]; ++i)
+            {
+                const Edge &edge = edges[rowEdges[i]];
+                addEdgeToClm(edge.from, edge.to, edge.extraNodes, edgeWeight(rowEdges[i]));
+            }
+        });
+    }
+    pool.wait();
 
-void Graph::setMaxNodes(const size_t maxNodes) noexcept
+    clmCurrent = true;
+}
+
+void Graph::reshapeClm(const ClmMatrix::Layout layout, const size_t maxNodes)
 {
+    ClmMatrix reshaped(layout, maxNodes);
+
+    // Carry the cells over while they still fit, otherwise leave the CLM to be rebuilt by the next mining
+    if (clmCurrent && (reshaped.getLayout() == ClmMatrix::Layout::Sparse || nodes.size() <= maxNodes))
+    {
+        for (const auto &[label, occurrence] : nodes)
+        {
+            CLM.forEachCell(label, [&](const ItemId major, const ItemId minor, const size_t count)
+            {
+                reshaped.set(label, major, minor, count);
+            });
+        }
+    }
+    else
+    {
+        clmCurrent = false;
+    }
+
+    clmLayout = layout;
     this->maxNodes = maxNodes;
-    this->maxRowSize = maxNodes * maxNodes + maxNodes;
+    CLM = std::move(reshaped);
 }
 
-void Graph::processTransaction(const std::string &str)
+void Graph::processTransactionLines(const std::string_view lines)
 {
-    // Process nodes
-    for (char it : str)
+    std::vector<std::string_view> items;
+    for (size_t offset = 0; offset < lines.length();)
     {
-        bool found = false;
-        for (auto &[fst, second] : nodes)
+        const size_t end = std::min(lines.find('\n', offset), lines.length());
+
+        splitItems(lines.substr(offset, end - offset), items);
+        if (!items.empty())
         {
-            if (fst == it)
-            {
-                found = true;
-                second++;
-            }
+            processTransaction(items);
         }
 
-        if (!found)
+        offset = end + 1;
+    }
+}
+
+void Graph::splitItems(const std::string_view line, std::vector<std::string_view> &items)
+{
+    items.clear();
+    for (size_t offset = 0; offset < line.length();)
+    {
+        while (offset < line.length() && std::isspace(static_cast<unsigned char>(line[offset])))
         {
-            nodes.emplace_back(it, 1);
+            ++offset;
+        }
+
+        const size_t start = offset;
+        while (offset < line.length() && !std::isspace(static_cast<unsigned char>(line[offset])))
+        {
+            ++offset;
+        }
+
+        if (offset > start)
+        {
+            items.push_back(line.substr(start, offset - start));
         }
     }
+}
 
-    // Process edges
-    for (int startIndex = 0; startIndex < (str.length() - 1); startIndex++)
+void Graph::mergePartials(const std::vector<Graph> &partials, const std::vector<size_t> &chunkOwners,
+                          const std::vector<std::vector<ChunkMark>> &marks, const size_t threads)
+{
+    // Visits every chunk in stream order with the sizes of its partial graph before and after it, what a chunk added
+    // to its partial graph lies between the two
+    const auto forEachChunk = [&](const auto &visitor)
+    {
+        std::vector<size_t> chunks(partials.size(), 0);
+        for (const size_t owner : chunkOwners)
+        {
+            const size_t chunk = chunks[owner]++;
+            const ChunkMark start = chunk > 0 ? marks[owner][chunk - 1] : ChunkMark{0, SuffixPool::empty + 1, 0};
+            visitor(owner, start, marks[owner][chunk]);
+        }
+    };
+
+    // Interning the new items and suffixes of every chunk in stream order hands out the IDs a single thread would have
+    std::vector<std::vector<ItemId>> ids(partials.size());
+    std::vector<std::vector<SuffixId>> suffixIds(partials.size());
+    for (size_t i = 0; i < partials.size(); ++i)
+    {
+        ids[i].resize(partials[i].nodes.size());
+        suffixIds[i].assign(partials[i].suffixes.size(), SuffixPool::empty);
+    }
+    forEachChunk([&](const size_t owner, const ChunkMark &start, const ChunkMark &end)
+    {
+        const Graph &partial = partials[owner];
+        for (size_t id = start.nodes; id < end.nodes; ++id)
+        {
+            ids[owner][id] = internItem(partial.dictionary.token(static_cast<ItemId>(id)));
+        }
+
+        const std::span<const SuffixPool::Node> partialSuffixes = partial.suffixes.getNodes();
+        for (size_t id = start.suffixes; id < end.suffixes; ++id)
+        {
+            const auto &[item, next] = partialSuffixes[id];
+            suffixIds[owner][id] = suffixes.extend(ids[owner][item], suffixIds[owner][next]);
+        }
+    });
+
+    for (size_t i = 0; i < partials.size(); ++i)
+    {
+        for (const auto &[label, occurrence] : partials[i].nodes)
+        {
+            nodes[ids[i][label]].occurrence += occurrence;
+        }
+    }
+
+    // Grow the CLM the way processing the transactions one by one grows it
+    size_t grown = maxNodes;
+    while (grown < nodes.size())
     {
-        char fromNode = str[startIndex];
+        grown *= 2;
+    }
+    setMaxNodes(grown);
+
+    struct EdgeKey {
+      ItemId from{};
+      ItemId to{};
+      SuffixId extraNodes{};
+
+      bool operator==(const EdgeKey &) const = default;
+    };
+    struct EdgeKeyHash {
+      size_t operator()(const EdgeKey &key) const noexcept
+      {
+          return hashEdge(key.from, key.to, key.extraNodes);
+      }
+    };
+
+    // Every shard task owns the edges whose from item falls into its shard and sums their weights into the existing edge
+    // or else into the first partial edge of the triple in stream order. Edges from transactions weigh at least 1, so
+    // the partial edges left at 0 are the ones that are not first
+    const size_t existingEdges = edges.size();
+    std::vector<size_t> existingWeights(existingEdges, 0);
+    std::vector<std::vector<size_t>> weights(partials.size());
+    for (size_t i = 0; i < partials.size(); ++i)
+    {
+        weights[i].assign(partials[i].edges.size(), 0);
+    }
 
-        for (int offsetIndex = startIndex + 1; offsetIndex < str.length(); ++offsetIndex)
+    // Bucket the edge indices of the existing edges and of every partial graph by shard once, a task per edge list, so
+    // every shard task only walks its own edges. The buckets keep the edges in order, so the edges of a chunk stay a
+    // contiguous run of each bucket
+    const auto shardOf = [threads](const ItemId from) { return from % threads; };
+    std::vector<std::vector<size_t>> existingBuckets(threads);
+    std::vector<std::vector<std::vector<size_t>>> buckets(partials.size(), std::vector<std::vector<size_t>>(threads));
+
+    ThreadPool pool(threads);
+    pool.submit([&]
+    {
+        for (size_t i = 0; i < existingEdges; ++i)
         {
-            char toNode = str[offsetIndex];
+            existingBuckets[shardOf(edges[i].from)].push_back(i);
+        }
+    });
+    for (size_t owner = 0; owner < partials.size(); ++owner)
+    {
+        pool.submit([&, owner]
+        {
+            const std::vector<Edge> &partialEdges = partials[owner].edges;
+            for (size_t i = 0; i < partialEdges.size(); ++i)
+            {
+                buckets[owner][shardOf(ids[owner][partialEdges[i].from])].push_back(i);
+            }
+        });
+    }
+    pool.wait();
 
-            std::list<char> extraNodes;
-            for (int i = offsetIndex + 1; i < str.length(); ++i)
+    for (size_t shard = 0; shard < threads; ++shard)
+    {
+        pool.submit([&, shard]
+        {
+            std::unordered_map<EdgeKey, size_t *, EdgeKeyHash> owned;
+            for (const size_t i : existingBuckets[shard])
             {
-                extraNodes.push_back(str[i]);
+                owned.emplace(EdgeKey{edges[i].from, edges[i].to, edges[i].extraNodes}, &existingWeights[i]);
             }
 
-            bool found = false;
-            for (auto &[existingFromNode, existingToNode, existingExtraNodes, existingWeight] : edges)
+            // The next edge of every bucket of this shard, chunks come in stream order and cover the edges in order
+            std::vector<size_t> cursors(partials.size(), 0);
+            forEachChunk([&](const size_t owner, const ChunkMark &, const ChunkMark &end)
             {
-                if (existingFromNode == fromNode && existingToNode == toNode && existingExtraNodes == extraNodes)
+                const Graph &partial = partials[owner];
+                const std::vector<size_t> &bucket = buckets[owner][shard];
+                for (size_t &cursor = cursors[owner]; cursor < bucket.size() && bucket[cursor] < end.edges; ++cursor)
                 {
-                    ++existingWeight;
-                    found = true;
-                    break;
+                    const size_t i = bucket[cursor];
+                    const Edge &edge = partial.edges[i];
+                    const EdgeKey key{ids[owner][edge.from], ids[owner][edge.to], suffixIds[owner][edge.extraNodes]};
+                    *owned.try_emplace(key, &weights[owner][i]).first->second += partial.edgeWeight(i);
                 }
+            });
+        });
+    }
+    pool.wait();
+
+    for (size_t i = 0; i < existingEdges; ++i)
+    {
+        if (existingWeights[i] > 0)
+        {
+            addEdgeWeight(i, existingWeights[i]);
+        }
+    }
+
+    forEachChunk([&](const size_t owner, const ChunkMark &start, const ChunkMark &end)
+    {
+        for (size_t i = start.edges; i < end.edges; ++i)
+        {
+            if (weights[owner][i] == 0)
+                continue;
+
+            const Edge &edge = partials[owner].edges[i];
+            edges.emplace_back(ids[owner][edge.from], ids[owner][edge.to], suffixIds[owner][edge.extraNodes], 0);
+            addEdgeWeight(edges.size() - 1, weights[owner][i]);
+        }
+    });
+
+    // The new edges are not in the edge index, it is rebuilt once edges are added one at a time again
+    edgeIndex.clear();
+    edgeIndexCurrent = false;
+}
+
+std::string Graph::itemsToString(const std::span<const ItemId> items) const
+{
+    std::string str;
+    for (const ItemId item : items)
+    {
+        if (!str.empty())
+        {
+            str += ' ';
+        }
+        str += dictionary.token(item);
+    }
+
+    return str;
+}
+
+void Graph::writeFI(JsonWriter &writer, const std::span<const ItemId> items, const size_t support) const
+{
+    // The tokens are escaped one by one, which writes the same string as escaping them once joined
+    writer.raw(R"({"itemset":")");
+    for (size_t i = 0; i < items.size(); ++i)
+    {
+        if (i > 0)
+        {
+            writer.raw(' ');
+        }
+        writer.stringPart(dictionary.token(items[i]));
+    }
+    writer.raw(R"(","support":)");
+    writer.number(support);
+    writer.raw('}');
+}
+
+
+// PUBLIC FUNCTIONS
+
+void Graph::setMaxNodes(const size_t maxNodes)
+{
+    // The CLM always needs a column for every item and never shrinks, it is only reshaped when it has to grow since
+    // reshaping copies every cell
+    const size_t width = std::max(maxNodes, nodes.size());
+    if (width <= this->maxNodes)
+        return;
+
+    reshapeClm(clmLayout, width);
+}
+
+void Graph::setClmLayout(const ClmMatrix::Layout layout)
+{
+    if (clmLayout == layout)
+        return;
+
+    reshapeClm(layout, maxNodes);
+}
+
+void Graph::processTransaction(const std::string &str)
+{
+    // Every UTF-8 character is an item, so is every byte that is not part of one, which the dictionary takes as Latin-1
+    const std::string_view transaction(str);
+    std::vector<ItemId> items;
+    items.reserve(transaction.length());
+    for (size_t offset = 0; offset < transaction.length();)
+    {
+        const size_t length = std::max<size_t>(ItemDictionary::utf8Length(transaction.substr(offset)), 1);
+        items.push_back(internItem(transaction.substr(offset, length)));
+        offset += length;
+    }
+
+    processItems(items);
+}
+
+void Graph::processTransaction(const std::span<const std::string_view> items)
+{
+    std::vector<ItemId> ids;
+    ids.reserve(items.size());
+    for (const std::string_view item : items)
+    {
+        ids.push_back(internItem(item));
+    }
+
+    processItems(ids);
+}
+
+void Graph::processTransactions(std::istream &stream, const size_t threads)
+{
+    std::vector<Graph> partials;
+    std::vector<ChunkQueue> queues(threads > 1 ? threads : 0);
+    std::vector<std::vector<ChunkMark>> marks(queues.size());
+    std::vector<size_t> chunkOwners;
+    std::vector<std::jthread> workers;
+    for (size_t i = 0; i < queues.size(); ++i)
+    {
+        // The CLM is only needed once the partial graphs are merged
+        partials.emplace_back(maxNodes).clmCurrent = false;
+    }
+    for (size_t i = 0; i < queues.size(); ++i)
+    {
+        workers.emplace_back([&partial = partials[i], &queue = queues[i], &marks = marks[i]]
+        {
+            std::string chunk;
+            while (queue.pop(chunk))
+            {
+                partial.processTransactionLines(chunk);
+                marks.emplace_back(partial.nodes.size(), partial.suffixes.size(), partial.edges.size());
             }
+        });
+    }
+
+    // Read blocks of whole lines, a partial line at the end of a block is carried over into the next one
+    std::string carry;
+    for (size_t next = 0; stream; next = (next + 1) % std::max<size_t>(queues.size(), 1))
+    {
+        std::string chunk = std::move(carry);
+        carry.clear();
+
+        const size_t offset = chunk.size();
+        chunk.resize(offset + chunkSize);
+        stream.read(chunk.data() + offset, chunkSize);
+        chunk.resize(offset + stream.gcount());
 
-            if (!found)
+        if (stream)
+        {
+            const size_t lastNewline = chunk.rfind('\n');
+            if (lastNewline == std::string::npos)
             {
-                edges.emplace_back(fromNode, toNode, extraNodes, 1);
+                carry = std::move(chunk);
+                continue;
             }
+
+            carry.assign(chunk, lastNewline + 1);
+            chunk.resize(lastNewline + 1);
+        }
+
+        if (queues.empty())
+        {
+            processTransactionLines(chunk);
         }
+        else
+        {
+            chunkOwners.push_back(next);
+            queues[next].push(std::move(chunk));
+        }
+    }
+
+    for (ChunkQueue &queue : queues)
+    {
+        queue.close();
+    }
+    workers.clear();
+
+    if (partials.empty())
+        return;
+
+    // Adding the edges of every partial graph to a current CLM would be one serial pass over all edges, rebuilding it
+    // once they are merged fills its rows in parallel instead
+    const bool rebuild = clmCurrent;
+    clmCurrent = false;
+    mergePartials(partials, chunkOwners, marks, threads);
+
+    if (rebuild)
+    {
+        rebuildClm(threads);
     }
 }
 
-std::list<std::string> Graph::useCLM_Miner(const int minSup)
+void Graph::merge(const Graph &other)
 {
-    // Set up CLM
-    nodes.sort();
-    for (const auto &[label, occurrence] : nodes)
+    ensureEdgeIndex();
+
+    // Translate the IDs of the other graph into IDs of this graph
+    std::vector<ItemId> ids(other.nodes.size());
+    for (const auto &[label, occurrence] : other.nodes)
     {
-        if (!CLM.contains(label))
-            CLM.emplace(label, std::vector<size_t>(maxRowSize, 0));
+        ids[label] = internItem(other.dictionary.token(label));
     }
 
-    // Fill CLM
-    // Update the individual nodes
-    for (const auto &[label, occurrence] : nodes)
+    if (nodes.size() > maxNodes)
     {
-        CLM[label][mapNodeToPosition(label) * (maxNodes + 1)] = occurrence;
+        setMaxNodes(std::max(nodes.size(), 2 * maxNodes));
     }
-    // Update using edges
-    for (const auto &[fromNode, toNode, extraNodes, occurrence] : edges)
+
+    for (const auto &[label, occurrence] : other.nodes)
     {
-        const size_t startPosX = mapNodeToPosition(toNode) * (maxNodes + 1);
-        CLM[fromNode][startPosX] += occurrence;
+        nodes[ids[label]].occurrence += occurrence;
 
-        for (const char &extraNode : extraNodes)
+        if (clmCurrent)
         {
-            CLM[fromNode][startPosX + mapNodeToPosition(extraNode) + 1] += occurrence;
+            CLM.add(ids[label], ids[label], ClmMatrix::majorCell, occurrence);
         }
     }
 
-    // Process FIs
-    std::list<std::string> FIs;
-
-    // Iterate over each row
-    for (auto &[label, row] : CLM)
+    // Both graphs order their transactions by token, so translated edges are valid edges of this graph, every suffix of
+    // the other graph is translated once
+    std::vector<SuffixId> suffixIds(other.suffixes.size(), SuffixPool::empty);
+    std::vector<bool> translated(other.suffixes.size(), false);
+    std::vector<ItemId> extraNodes;
+    for (size_t i = 0; i < other.edges.size(); ++i)
     {
-        // Iterate over major columns
-        for (size_t i = 0; i < maxRowSize; i += (maxNodes + 1))
+        const ItemId fromNode = other.edges[i].from;
+        const ItemId toNode = other.edges[i].to;
+        const SuffixId otherExtraNodes = other.edges[i].extraNodes;
+        const size_t occurrence = other.edgeWeight(i);
+
+        if (!translated[otherExtraNodes])
         {
-            // If the major column support count is greater than the minimum support count, check the minor columns
-            if (row[i] >= minSup)
+            extraNodes.clear();
+            for (const ItemId extraNode : other.suffixes.get(otherExtraNodes))
             {
-                // Add the row and major column to FIs
-                std::string temp;
-                temp += label;
-                const char _ = mapPostionToNode(i % maxNodes);
-                if (_ == label)
-                {
-                    FIs.push_back(temp);
-                    continue;
-                }
-                temp += _;
+                extraNodes.push_back(ids[extraNode]);
+            }
+            suffixIds[otherExtraNodes] = suffixes.intern(extraNodes);
+            translated[otherExtraNodes] = true;
+        }
+        const SuffixId extraNodeIds = suffixIds[otherExtraNodes];
 
-                FIs.push_back(temp);
+        if (clmCurrent)
+        {
+            addEdgeToClm(ids[fromNode], ids[toNode], extraNodeIds, occurrence);
+        }
 
-                std::string _temp;
-                size_t j = maxNodes + i; // Starting from the final minor column
-                while (j > i)
-                {
-                    if (row[j] >= minSup)
-                    {
-                        // Add Row + Major Col + Minor Col to FIs
-                        _temp = mapPostionToNode(j - i - 1);
-                        FIs.push_back(temp + _temp);
-
-                        // TODO FIX for FIs greater than 3-items
-                        size_t k = j - 1;
-                        size_t colMinSup = row[j];
-                        while (colMinSup >= minSup && row[k] >= minSup)
-                        {
-                            _temp.insert(0, 1, mapPostionToNode(k - i - 1));
-                            FIs.push_back(temp + _temp);
-                            colMinSup--;
-                            k--;
-                        }
-                    }
-                    j--;
-                }
-            }
+        if (const size_t edge = findEdge(ids[fromNode], ids[toNode], extraNodeIds); edge != noEdge)
+        {
+            addEdgeWeight(edge, occurrence);
+        }
+        else
+        {
+            addEdge(ids[fromNode], ids[toNode], extraNodeIds, occurrence);
         }
     }
+}
 
-    return FIs;
+bool Graph::isClmCurrent() const noexcept
+{
+    return clmCurrent;
 }
 
 std::string Graph::toString() const noexcept
 {
     std::stringstream ss;
+    const std::vector<ItemId> order = dictionary.sorted();
 
     ss << "Nodes: \n\tnode : weight\n";
-    for (const auto &[node, occurrence] : nodes)
+    for (const ItemId node : order)
     {
-        ss << '\t' << node << " : " << occurrence << '\n';
+        ss << '\t' << dictionary.token(node) << " : " << nodes[node].occurrence << '\n';
     }
 
     ss << "Edges: \n\tfrom : to : extra information : weight\n";
-    for (const auto &[fromNode, toNode, extraNodes, weight] : edges)
+    for (size_t i = 0; i < edges.size(); ++i)
     {
-        ss << '\t' << fromNode << " : " << toNode << " : ";
+        ss << '\t' << dictionary.token(edges[i].from) << " : " << dictionary.token(edges[i].to) << " : ";
 
-        for (const auto &node : extraNodes)
+        for (const auto &node : suffixes.get(edges[i].extraNodes))
         {
-            ss << node << ',';
+            ss << dictionary.token(node) << ',';
         }
 
-        ss << " : " << weight << '\n';
+        ss << " : " << edgeWeight(i) << '\n';
+    }
+
+    // Sparse rows only list their non-zero cells, a full matrix would be cubic in the number of items
+    if (CLM.getLayout() == ClmMatrix::Layout::Sparse)
+    {
+        std::vector<uint32_t> ranks(order.size());
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            ranks[order[i]] = static_cast<uint32_t>(i);
+        }
+
+        ss << "CLM: \n\trow : major : minor : count\n";
+        std::vector<std::tuple<uint32_t, uint32_t, size_t>> cells;
+        for (const ItemId label : order)
+        {
+            // The major cell sorts before the minor cells of its column
+            cells.clear();
+            CLM.forEachCell(label, [&](const ItemId major, const ItemId minor, const size_t count)
+            {
+                cells.emplace_back(ranks[major], minor == ClmMatrix::majorCell ? 0 : ranks[minor] + 1, count);
+            });
+            std::sort(cells.begin(), cells.end());
+
+            for (const auto &[major, minor, count] : cells)
+            {
+                ss << '\t' << dictionary.token(label) << " : " << dictionary.token(order[major]) << " : "
+                   << (minor == 0 ? "" : dictionary.token(order[minor - 1])) << " : " << count << '\n';
+            }
+        }
+
+        return ss.str();
     }
 
     ss << "CLM: \n\t  | ";
-    for (const auto& [label, occurrence] : nodes)
+    for (const ItemId label : order)
     {
-        ss << label << " | ";
-        for (const auto& [label, occurrence] : nodes)
+        ss << dictionary.token(label) << " | ";
+        for (const ItemId minor : order)
         {
-            ss << label << " ";
+            ss << dictionary.token(minor) << " ";
         }
         ss << "| ";
     }
     ss << '\n';
 
-    for (const auto& [label, row] : CLM)
+    for (const ItemId label : order)
     {
-        ss << '\t' << label << " | ";
-
-        int j = 0;
-        for (const auto& val : row)
+        if (!CLM.hasRow(label))
         {
-            if (j == 1)
-            {
-                ss << "| ";
-            }
-
-            ss << val << ' ';
+            continue;
+        }
 
-            j++;
-            if (j == (maxNodes + 1))
+        ss << '\t' << dictionary.token(label) << " | ";
+        for (const ItemId major : order)
+        {
+            ss << CLM.get(label, major) << " | ";
+            for (const ItemId minor : order)
             {
-                ss << "| ";
-                j = 0;
+                ss << CLM.get(label, major, minor) << ' ';
             }
+            ss << "| ";
         }
 
         ss << '\n';
@@ -0,0 +1,451 @@
+#include "../include/Graph.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <tuple>
+
+/**
+ * \brief Receives the events of nlohmann's SAX parser for a graph image and fills the nodes and edges of a graph as they
+ * are parsed, so no JSON value is ever built. Images are objects of the form
+ * {"nodes": [{"label", "occurrence"}...], "edges": [{"from", "to", "extraNodes", "occurrence"}...], "CLM": {...}} where
+ * the keys of an object may come in any order. The CLM is derived from the nodes and edges, so it is skipped and
+ * rebuilt when mining instead of being read back
+ */
+class Graph::ImageReader
+{
+    enum class Section
+    {
+        None,
+        Nodes,
+        Edges
+    };
+
+    enum class Field
+    {
+        None,
+        Label,
+        From,
+        To,
+        ExtraNodes,
+        Occurrence
+    };
+
+    Graph &graph;
+    size_t depth = 0; // The number of objects and arrays entered that are not skipped
+    size_t skipping = 0; // The number of objects and arrays entered inside a skipped value
+    bool skipNext = false; // Whether the next value is skipped, set for keys the image does not need
+    bool sawNodes = false;
+    bool sawEdges = false;
+
+    Section section = Section::None;
+    Field field = Field::None;
+    unsigned fields = 0; // The fields of the current node or edge seen so far, a bit per Field
+    ItemId label{};
+    ItemId from{};
+    ItemId to{};
+    size_t occurrence{};
+    std::vector<ItemId> extraNodes;
+
+    [[nodiscard]] static unsigned bit(const Field field) noexcept
+    {
+        return 1u << static_cast<unsigned>(field);
+    }
+
+    [[noreturn]] static void fail(const std::string &what)
+    {
+        throw std::runtime_error("Invalid graph image, " + what);
+    }
+
+    /**
+     * \brief Skips a scalar that is inside a skipped value or is the skipped value itself
+     * \return True if the scalar is skipped
+     */
+    bool skipScalar() noexcept
+    {
+        if (skipping > 0)
+            return true;
+        if (skipNext)
+        {
+            skipNext = false;
+            return true;
+        }
+
+        return false;
+    }
+
+    /**
+     * \brief Skips an object or array that is inside a skipped value or is the skipped value itself
+     * \return True if the container is skipped
+     */
+    bool skipContainer() noexcept
+    {
+        if (skipping > 0 || skipNext)
+        {
+            ++skipping;
+            skipNext = false;
+            return true;
+        }
+
+        return false;
+    }
+
+    /**
+     * \brief Takes an item token, the label of a node, the from or to item of an edge or one of its extra nodes
+     */
+    bool token(const std::string_view token)
+    {
+        const ItemId id = graph.internItem(token);
+        if (depth == 4)
+        {
+            extraNodes.push_back(id);
+            return true;
+        }
+
+        if (depth != 3 || (field != Field::Label && field != Field::From && field != Field::To))
+            fail("unexpected string");
+
+        (field == Field::Label ? label : field == Field::From ? from : to) = id;
+        fields |= bit(field);
+        return true;
+    }
+
+    /**
+     * \brief Checks if a number at the current position is an item, the label of a node, the from or to item of an edge
+     * or one of its extra nodes
+     */
+    [[nodiscard]] bool atLabel() const noexcept
+    {
+        return depth == 4 || (depth == 3 && field != Field::Occurrence);
+    }
+
+    bool count(const size_t value)
+    {
+        // Images written before items became tokens store the labels as character codes, the codes from 0x80 on become
+        // the Latin-1 characters U+0080 to U+00FF in the dictionary. That keeps their canonical order, which their
+        // edges are still checked for once they are complete
+        if (atLabel())
+        {
+            const char code = static_cast<char>(value);
+            return token(std::string_view(&code, 1));
+        }
+
+        if (depth != 3)
+            fail("unexpected number");
+
+        occurrence = value;
+        fields |= bit(Field::Occurrence);
+        return true;
+    }
+
+public:
+    explicit ImageReader(Graph &graph) : graph(graph) {}
+
+    /**
+     * \brief Checks that the image held both the nodes and the edges and finishes the graph
+     */
+    void finish()
+    {
+        if (!sawNodes || !sawEdges)
+            fail("the nodes or edges are missing");
+
+        graph.edgeIndexCurrent = false;
+    }
+
+    bool null()
+    {
+        if (!skipScalar())
+            fail("unexpected null");
+        return true;
+    }
+
+    bool boolean(bool)
+    {
+        if (!skipScalar())
+            fail("unexpected boolean");
+        return true;
+    }
+
+    bool number_integer(const nlohmann::json::number_integer_t value)
+    {
+        if (skipScalar())
+            return true;
+
+        // The character codes of legacy labels are negative for the bytes from 0x80 on where char is signed
+        if (value < 0)
+        {
+            if (!atLabel() || value < std::numeric_limits<signed char>::min())
+                fail("negative number");
+
+            return count(static_cast<unsigned char>(static_cast<char>(value)));
+        }
+
+        return count(static_cast<size_t>(value));
+    }
+
+    bool number_unsigned(const nlohmann::json::number_unsigned_t value)
+    {
+        if (skipScalar())
+            return true;
+
+        return count(static_cast<size_t>(value));
+    }
+
+    bool number_float(nlohmann::json::number_float_t, const std::string &)
+    {
+        if (!skipScalar())
+            fail("unexpected fraction");
+        return true;
+    }
+
+    bool string(std::string &value)
+    {
+        if (skipScalar())
+            return true;
+
+        return token(value);
+    }
+
+    bool binary(nlohmann::json::binary_t &)
+    {
+        if (!skipScalar())
+            fail("unexpected binary value");
+        return true;
+    }
+
+    bool start_object(std::size_t)
+    {
+        if (skipContainer())
+            return true;
+
+        if (depth == 2)
+        {
+            fields = 0;
+            extraNodes.clear();
+        }
+        else if (depth != 0)
+        {
+            fail("unexpected object");
+        }
+
+        ++depth;
+        return true;
+    }
+
+    bool key(std::string &key)
+    {
+        if (skipping > 0)
+            return true;
+
+        if (depth == 1)
+        {
+            section = key == "nodes" ? Section::Nodes : key == "edges" ? Section::Edges : Section::None;
+            skipNext = section == Section::None;
+            return true;
+        }
+
+        if (section == Section::Nodes)
+            field = key == "label" ? Field::Label : key == "occurrence" ? Field::Occurrence : Field::None;
+        else
+            field = key == "from" ? Field::From : key == "to" ? Field::To : key == "extraNodes" ? Field::ExtraNodes
+                  : key == "occurrence" ? Field::Occurrence : Field::None;
+        skipNext = field == Field::None;
+        return true;
+    }
+
+    bool end_object()
+    {
+        if (skipping > 0)
+        {
+            --skipping;
+            return true;
+        }
+
+        --depth;
+        if (depth != 2)
+            return true;
+
+        if (section == Section::Nodes)
+        {
+            if (fields != (bit(Field::Label) | bit(Field::Occurrence)))
+                fail("a node is missing its label or occurrence");
+
+            graph.nodes[label].occurrence += occurrence;
+            return true;
+        }
+
+        if (fields != (bit(Field::From) | bit(Field::To) | bit(Field::ExtraNodes) | bit(Field::Occurrence)))
+            fail("an edge is missing its from, to, extraNodes or occurrence");
+        if (!graph.isCanonicalEdge(from, to, extraNodes))
+            fail("an edge is not in the canonical item order");
+
+        Edge &added = graph.edges.emplace_back();
+        added.from = from;
+        added.to = to;
+        added.extraNodes = graph.suffixes.intern(extraNodes);
+        graph.addEdgeWeight(graph.edges.size() - 1, occurrence);
+        return true;
+    }
+
+    bool start_array(std::size_t)
+    {
+        if (skipContainer())
+            return true;
+
+        if (depth == 1)
+        {
+            (section == Section::Nodes ? sawNodes : sawEdges) = true;
+        }
+        else if (depth == 3 && field == Field::ExtraNodes)
+        {
+            fields |= bit(Field::ExtraNodes);
+        }
+        else
+        {
+            fail("unexpected array");
+        }
+
+        ++depth;
+        return true;
+    }
+
+    bool end_array()
+    {
+        if (skipping > 0)
+        {
+            --skipping;
+            return true;
+        }
+
+        --depth;
+        return true;
+    }
+
+    template <typename Exception>
+    bool parse_error(std::size_t, const std::string &, const Exception &exception)
+    {
+        throw exception;
+    }
+};
+
+Graph Graph::loadImage(std::istream &stream)
+{
+    Graph graph;
+    graph.clmCurrent = false;
+
+    ImageReader reader(graph);
+    nlohmann::json::sax_parse(stream, &reader);
+    reader.finish();
+
+    return graph;
+}
+
+void Graph::writeImage(std::ostream &stream) const
+{
+    // Images used to be dumped from nlohmann::json objects, which keep their keys sorted, so the sections, the fields
+    // and the CLM rows are written in the order of their keys to keep giving the same document
+    const std::vector<ItemId> order = dictionary.sorted();
+    std::vector<uint32_t> ranks(order.size());
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        ranks[order[i]] = static_cast<uint32_t>(i);
+    }
+    JsonWriter writer(stream);
+
+    writer.raw(R"({"CLM":{)");
+    std::vector<ItemId> rows;
+    std::ranges::copy_if(order, std::back_inserter(rows), [this](const ItemId label) { return CLM.hasRow(label); });
+    std::ranges::sort(rows, [this](const ItemId lhs, const ItemId rhs)
+    {
+        return dictionary.token(lhs) < dictionary.token(rhs);
+    });
+
+    std::vector<std::tuple<uint32_t, uint32_t, size_t>> cells;
+    for (size_t i = 0; i < rows.size(); ++i)
+    {
+        const ItemId label = rows[i];
+        if (i > 0)
+        {
+            writer.raw(',');
+        }
+        writer.string(dictionary.token(label));
+        writer.raw(":[");
+
+        // Dense rows are written with their columns in the same order as the nodes, sparse rows only list their
+        // non-zero cells as [major, minor, count] where the minor is null for the major column
+        if (CLM.getLayout() == ClmMatrix::Layout::Sparse)
+        {
+            // Sparse rows are visited in hash order, sort the cells by the canonical order of their columns so that the
+            // output does not depend on the item IDs, the major cell sorts before the minor cells of its column
+            cells.clear();
+            CLM.forEachCell(label, [&](const ItemId major, const ItemId minor, const size_t count)
+            {
+                cells.emplace_back(ranks[major], minor == ClmMatrix::majorCell ? 0 : ranks[minor] + 1, count);
+            });
+            std::ranges::sort(cells);
+
+            for (size_t j = 0; j < cells.size(); ++j)
+            {
+                const auto &[major, minor, count] = cells[j];
+                writer.raw(j > 0 ? ",[" : "[");
+                writer.string(dictionary.token(order[major]));
+                writer.raw(',');
+                if (minor == 0)
+                    writer.null();
+                else
+                    writer.string(dictionary.token(order[minor - 1]));
+                writer.raw(',');
+                writer.number(count);
+                writer.raw(']');
+            }
+        }
+        else
+        {
+            bool first = true;
+            for (const ItemId major : order)
+            {
+                writer.raw(first ? "" : ",");
+                writer.number(CLM.get(label, major));
+                for (const ItemId minor : order)
+                {
+                    writer.raw(',');
+                    writer.number(CLM.get(label, major, minor));
+                }
+                first = false;
+            }
+        }
+        writer.raw(']');
+    }
+
+    writer.raw(R"(},"edges":[)");
+    for (size_t i = 0; i < edges.size(); ++i)
+    {
+        const Edge &edge = edges[i];
+        writer.raw(i > 0 ? R"(,{"extraNodes":[)" : R"({"extraNodes":[)");
+        bool first = true;
+        for (const ItemId extraNode : suffixes.get(edge.extraNodes))
+        {
+            writer.raw(first ? "" : ",");
+            writer.string(dictionary.token(extraNode));
+            first = false;
+        }
+        writer.raw(R"(],"from":)");
+        writer.string(dictionary.token(edge.from));
+        writer.raw(R"(,"occurrence":)");
+        writer.number(edgeWeight(i));
+        writer.raw(R"(,"to":)");
+        writer.string(dictionary.token(edge.to));
+        writer.raw('}');
+    }
+
+    writer.raw(R"(],"nodes":[)");
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        writer.raw(i > 0 ? R"(,{"label":)" : R"({"label":)");
+        writer.string(dictionary.token(order[i]));
+        writer.raw(R"(,"occurrence":)");
+        writer.number(nodes[order[i]].occurrence);
+        writer.raw('}');
+    }
+    writer.raw("]}");
+}
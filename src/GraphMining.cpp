@@ -0,0 +1,811 @@
+#include "../include/Graph.hpp"
+#include "../include/ThreadPool.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <queue>
+
+namespace
+{
+    // A projected database, the suffixes that follow the current itemset in the transactions containing it, each
+    // with the number of those transactions
+    using Projection = std::vector<std::pair<SuffixId, size_t>>;
+
+    // Itemsets reported for a row by their index in the order they were found
+    using Focus = std::vector<uint32_t>;
+
+    // An itemset kept by the top k with its items in the canonical order
+    struct Itemset {
+      std::vector<ItemId> items;
+      size_t support{};
+    };
+
+    // An itemset of a row buffer, the view stays valid as the buffer is not added to once its row is handed out
+    struct ItemsetView {
+      std::span<const ItemId> items;
+      size_t support{};
+    };
+
+    // Per thread buffers indexed by item ID, counts is all zero between uses
+    struct Scratch {
+      std::vector<size_t> counts;
+      std::vector<uint32_t> marks;
+      uint32_t mark = 0;
+    };
+
+    Scratch &scratch(const size_t items)
+    {
+        thread_local Scratch buffers;
+        if (buffers.counts.size() < items)
+        {
+            buffers.counts.resize(items, 0);
+            buffers.marks.resize(items, 0);
+        }
+
+        return buffers;
+    }
+
+    /**
+     * \brief Sums the weights of equal suffixes, which keeps the projections from growing with the number of edges
+     */
+    void mergeProjection(Projection &projection)
+    {
+        std::sort(projection.begin(), projection.end());
+
+        size_t size = 0;
+        for (size_t i = 0; i < projection.size(); ++i)
+        {
+            if (size > 0 && projection[size - 1].first == projection[i].first)
+                projection[size - 1].second += projection[i].second;
+            else
+                projection[size++] = projection[i];
+        }
+        projection.resize(size);
+    }
+
+    // Orders items by their position in the canonical order
+    struct RankOrder {
+      const std::vector<uint32_t> &ranks;
+
+      bool operator()(const ItemId lhs, const ItemId rhs) const noexcept
+      {
+          return ranks[lhs] < ranks[rhs];
+      }
+    };
+
+    /**
+     * \brief Marks the candidates that are contained in an itemset of a pool. Each time the candidates are split by
+     * their next item the pool is narrowed to the itemsets holding that item, so every itemset of the pool is only
+     * compared with the candidates that share a prefix with it
+     * \param candidates The candidates, sorted in the canonical order
+     * \param begin The first of the candidates that share their first depth items
+     * \param end The candidate after the last one sharing those items
+     * \param depth The number of shared items
+     * \param pool The itemsets containing the shared items, none of them is equal to a candidate
+     * \param order The canonical order
+     * \param sameSupport Whether a candidate is only contained in an itemset of the same support
+     * \param contained Set for every candidate contained in an itemset of the pool
+     */
+    void markContained(const std::vector<ItemsetView> &candidates, size_t begin, const size_t end, const size_t depth,
+                       const std::vector<ItemsetView> &pool, const RankOrder order, const bool sameSupport,
+                       std::vector<bool> &contained)
+    {
+        if (pool.empty())
+            return;
+
+        // Sorting puts a candidate of just the shared items first
+        if (candidates[begin].items.size() == depth)
+        {
+            contained[begin] = !sameSupport || std::ranges::any_of(pool, [&](const ItemsetView &itemset)
+            {
+                return itemset.support == candidates[begin].support;
+            });
+            ++begin;
+        }
+
+        std::vector<ItemsetView> narrowed;
+        for (size_t next; begin < end; begin = next)
+        {
+            const ItemId item = candidates[begin].items[depth];
+            for (next = begin; next < end && candidates[next].items[depth] == item; ++next)
+            {
+            }
+
+            narrowed.clear();
+            std::ranges::copy_if(pool, std::back_inserter(narrowed), [&](const ItemsetView &itemset)
+            {
+                return std::binary_search(itemset.items.begin(), itemset.items.end(), item, order);
+            });
+            markContained(candidates, begin, next, depth + 1, narrowed, order, sameSupport, contained);
+        }
+    }
+
+    // The k best itemsets offered so far, by support and then by the canonical order. Once it is full the support of
+    // its worst itemset is the minimum support, as no itemset below it can get in any more
+    class TopK
+    {
+        const size_t k;
+        const RankOrder order;
+        std::atomic<size_t> &minSupport;
+        std::mutex mutex;
+        std::vector<Itemset> heap; // The worst itemset is at the front
+
+        [[nodiscard]] bool better(const Itemset &lhs, const Itemset &rhs) const
+        {
+            if (lhs.support != rhs.support)
+                return lhs.support > rhs.support;
+            return std::ranges::lexicographical_compare(lhs.items, rhs.items, order);
+        }
+
+    public:
+        TopK(const size_t k, const RankOrder order, std::atomic<size_t> &minSupport) :
+            k(k), order(order), minSupport(minSupport) {}
+
+        void offer(const std::span<const ItemId> items, const size_t support)
+        {
+            // Most itemsets fall below the minimum support once the heap has filled, these never take the lock
+            if (support < minSupport.load(std::memory_order_relaxed))
+                return;
+
+            Itemset itemset{{items.begin(), items.end()}, support};
+            // Ordering the heap by better keeps the worst itemset at its front
+            const auto heapOrder = [this](const Itemset &lhs, const Itemset &rhs) { return better(lhs, rhs); };
+
+            std::lock_guard lock(mutex);
+            if (heap.size() == k)
+            {
+                if (!better(itemset, heap.front()))
+                    return;
+
+                std::ranges::pop_heap(heap, heapOrder);
+                heap.back() = std::move(itemset);
+            }
+            else
+            {
+                heap.push_back(std::move(itemset));
+            }
+            std::ranges::push_heap(heap, heapOrder);
+
+            if (heap.size() == k && heap.front().support > minSupport.load(std::memory_order_relaxed))
+                minSupport.store(heap.front().support, std::memory_order_relaxed);
+        }
+
+        /**
+         * \brief Takes the itemsets out of the heap
+         * \return The itemsets, best first
+         */
+        std::vector<Itemset> take()
+        {
+            std::ranges::sort(heap, [this](const Itemset &lhs, const Itemset &rhs) { return better(lhs, rhs); });
+            return std::move(heap);
+        }
+    };
+}
+
+/**
+ * \brief Enumerates the FIs whose first item is the row of a CLM, every FI is grown one item at a time in the canonical
+ * order from the projection of the edges onto the current itemset. An item is only counted when the CLM cell of the
+ * row, the last item and the item is frequent, which prunes by anti-monotonicity before any suffix is walked.
+ *
+ * When mining MFIs only the itemsets without a frequent extension are reported, and only if no MFI found earlier in
+ * the row contains them. When mining closed FIs the extensions found in every transaction of an itemset join its
+ * closure instead of being branched on, and the closure is only reported if no closed FI of the same support found
+ * earlier in the row contains it, otherwise the whole branch is skipped as its closed FIs were found with that one.
+ * The enumeration visits every superset of an itemset either before it or below it, so this leaves the MFIs or closed
+ * FIs of the row apart from those contained in one of an earlier row. Every itemset carries the focus, the reported
+ * itemsets that contain it, so that these checks never look at an unrelated itemset
+ */
+class Graph::RowMiner
+{
+    const Graph &graph;
+    const std::vector<uint32_t> &ranks; // The position of every item in the canonical order
+    const std::atomic<size_t> &minSupport;
+    const FiVisitor &visitor;
+    const MiningMode mode;
+    Scratch &buffers;
+
+    ItemId label{};
+    bool dense = false;
+    ThresholdMask frequent;
+    std::vector<ItemId> itemset; // The items branched on
+    std::vector<ItemId> closure; // The items that joined the closure of the itemset
+    std::vector<ItemId> joined; // Reused for the itemset joined with its extensions or its closure
+    FrequentItemsets reported; // The MFIs or closed FIs reported for the row
+
+    // The minimum support can be raised by another row while this one is mined, an itemset that passed an earlier
+    // threshold is still safe to report as only the visitor decides what is kept
+    [[nodiscard]] size_t threshold() const noexcept
+    {
+        return minSupport.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] bool isFrequent(const ItemId major, const ItemId minor = ClmMatrix::majorCell) const
+    {
+        return dense ? frequent.test(graph.CLM.denseIndex(major, minor))
+                     : graph.CLM.get(label, major, minor) >= threshold();
+    }
+
+    /**
+     * \brief Projects onto one more item, keeping the part of every suffix after the item
+     */
+    [[nodiscard]] Projection project(const Projection &projection, const ItemId item) const
+    {
+        Projection projected;
+        for (const auto &[suffix, weight] : projection)
+        {
+            // Suffixes are in the canonical order, so the walk stops once it is past the item
+            SuffixId id = suffix;
+            while (id != SuffixPool::empty && ranks[graph.suffixes.head(id)] < ranks[item])
+            {
+                id = graph.suffixes.tail(id);
+            }
+
+            if (id != SuffixPool::empty && graph.suffixes.head(id) == item &&
+                graph.suffixes.tail(id) != SuffixPool::empty)
+            {
+                projected.emplace_back(graph.suffixes.tail(id), weight);
+            }
+        }
+        mergeProjection(projected);
+
+        return projected;
+    }
+
+    /**
+     * \brief Checks if an itemset reported for the row contains items that extend the current itemset, for closed FIs
+     * the reported itemset must also have the given support
+     * \param items The items in the canonical order
+     * \param support The support of the items
+     * \param focus The reported itemsets found before the current itemset was entered that contain it
+     * \param first The number of reported itemsets when the current itemset was entered, every one since lies below it
+     */
+    [[nodiscard]] bool isContained(const std::span<const ItemId> items, const size_t support, const Focus &focus,
+                                   const size_t first) const
+    {
+        const auto contains = [&](const size_t i)
+        {
+            const std::span<const ItemId> superset = reported.items(i);
+            return (mode != MiningMode::Closed || reported.support(i) == support) &&
+                   std::includes(superset.begin(), superset.end(), items.begin(), items.end(), RankOrder{ranks});
+        };
+
+        if (std::ranges::any_of(focus, contains))
+            return true;
+        for (size_t i = first; i < reported.size(); ++i)
+        {
+            if (contains(i))
+                return true;
+        }
+
+        return false;
+    }
+
+    /**
+     * \brief Narrows the focus of the current itemset to the itemset joined with one more item
+     * \param focus The reported itemsets found before the current itemset was entered that contain it
+     * \param first The number of reported itemsets when the current itemset was entered
+     * \param item The item joined with the current itemset
+     * \return The reported itemsets that contain the joined itemset
+     */
+    [[nodiscard]] Focus narrow(const Focus &focus, const size_t first, const ItemId item) const
+    {
+        const auto contains = [&](const size_t i)
+        {
+            const std::span<const ItemId> superset = reported.items(i);
+            return std::binary_search(superset.begin(), superset.end(), item, RankOrder{ranks});
+        };
+
+        Focus narrowed;
+        std::ranges::copy_if(focus, std::back_inserter(narrowed), contains);
+        for (size_t i = first; i < reported.size(); ++i)
+        {
+            if (contains(i))
+                narrowed.push_back(static_cast<uint32_t>(i));
+        }
+
+        return narrowed;
+    }
+
+    void report(const std::span<const ItemId> items, const size_t support)
+    {
+        visitor(items, support);
+        reported.add(items, support);
+    }
+
+    /**
+     * \brief Looks ahead to the union of the current itemset and all of its frequent extensions, which contains every
+     * itemset below the current one. If an MFI of the row contains the union there is no MFI below the itemset, and if
+     * the union is frequent it is the only one
+     * \param projection The projection of the edges onto the current itemset
+     * \param extensions The frequent extensions of the itemset in the canonical order
+     * \param focus The MFIs found before the current itemset was entered that contain it
+     * \param first The number of MFIs when the current itemset was entered
+     * \return True if the itemsets below the current one need not be enumerated
+     */
+    bool lookAhead(const Projection &projection, const std::vector<ItemId> &extensions, const Focus &focus,
+                   const size_t first)
+    {
+        if (isContained(extensions, 0, focus, first))
+            return true;
+
+        // Both the suffixes and the extensions are in the canonical order, so one merge-like walk tells if a suffix
+        // holds every extension
+        size_t support = 0;
+        for (const auto &[suffix, weight] : projection)
+        {
+            size_t matched = 0;
+            for (SuffixId id = suffix; id != SuffixPool::empty && matched < extensions.size();
+                 id = graph.suffixes.tail(id))
+            {
+                const ItemId item = graph.suffixes.head(id);
+                if (item == extensions[matched])
+                    ++matched;
+                else if (ranks[item] > ranks[extensions[matched]])
+                    break;
+            }
+
+            if (matched == extensions.size())
+                support += weight;
+        }
+        if (support < threshold())
+            return false;
+
+        joined.assign(itemset.begin(), itemset.end());
+        joined.insert(joined.end(), extensions.begin(), extensions.end());
+        report(joined, support);
+
+        return true;
+    }
+
+    /**
+     * \brief Moves the extensions found in every transaction of the current itemset into its closure and reports the
+     * closed itemset, unless a closed FI of the same support found earlier contains it
+     * \param extensions The frequent extensions of the itemset, left with the ones to branch on
+     * \param supports The supports of the extensions
+     * \param support The support of the current itemset
+     * \param focus The closed FIs found before the current itemset was entered that contain it
+     * \param first The number of closed FIs when the current itemset was entered
+     * \return False if the closed FIs below the current itemset were already found
+     */
+    bool close(std::vector<ItemId> &extensions, std::vector<size_t> &supports, const size_t support,
+               const Focus &focus, const size_t first)
+    {
+        size_t size = 0;
+        for (size_t i = 0; i < extensions.size(); ++i)
+        {
+            if (supports[i] < support)
+            {
+                extensions[size] = extensions[i];
+                supports[size++] = supports[i];
+            }
+            else if (std::ranges::find(closure, extensions[i]) == closure.end())
+            {
+                closure.push_back(extensions[i]);
+            }
+        }
+        extensions.resize(size);
+        supports.resize(size);
+
+        joined.assign(itemset.begin(), itemset.end());
+        joined.insert(joined.end(), closure.begin(), closure.end());
+        std::ranges::sort(joined, RankOrder{ranks});
+        if (isContained(joined, support, focus, first))
+            return false;
+
+        report(joined, support);
+        return true;
+    }
+
+    /**
+     * \brief Reports every frequent extension of the current itemset and recurses into it
+     * \param projection The projection of the edges onto the current itemset
+     * \param candidates The items that may extend the itemset in the canonical order, every item if null
+     * \param support The support of the current itemset
+     * \param focus The reported itemsets that contain the current itemset, only kept when mining MFIs or closed FIs
+     */
+    void extend(const Projection &projection, const std::vector<ItemId> *candidates, const size_t support,
+                const Focus &focus)
+    {
+        const size_t first = reported.size();
+        const size_t closed = closure.size();
+        const ItemId last = itemset.back();
+        const uint32_t mark = ++buffers.mark;
+        if (candidates != nullptr)
+        {
+            for (const ItemId candidate : *candidates)
+            {
+                buffers.marks[candidate] = mark;
+            }
+        }
+
+        // Count the support of every item that may still extend the itemset
+        std::vector<ItemId> counted;
+        for (const auto &[suffix, weight] : projection)
+        {
+            for (const ItemId item : graph.suffixes.get(suffix))
+            {
+                if (candidates != nullptr && buffers.marks[item] != mark)
+                    continue;
+
+                if (buffers.counts[item] == 0)
+                {
+                    if (!isFrequent(last, item))
+                    {
+                        continue;
+                    }
+                    counted.push_back(item);
+                }
+                buffers.counts[item] += weight;
+            }
+        }
+
+        std::vector<ItemId> extensions;
+        std::vector<size_t> supports;
+        std::sort(counted.begin(), counted.end(), RankOrder{ranks});
+        for (const ItemId item : counted)
+        {
+            if (buffers.counts[item] >= threshold())
+            {
+                extensions.push_back(item);
+                supports.push_back(buffers.counts[item]);
+            }
+            buffers.counts[item] = 0;
+        }
+
+        if (mode == MiningMode::Maximal)
+        {
+            if (extensions.empty())
+            {
+                if (focus.empty())
+                    report(itemset, support);
+                return;
+            }
+            if (extensions.size() > 1 && lookAhead(projection, extensions, focus, first))
+                return;
+        }
+        else if (mode == MiningMode::Closed && !close(extensions, supports, support, focus, first))
+        {
+            closure.resize(closed);
+            return;
+        }
+
+        // Only items that extend this itemset can extend a larger one
+        std::vector<ItemId> later;
+        for (size_t i = 0; i < extensions.size(); ++i)
+        {
+            itemset.push_back(extensions[i]);
+            if (mode == MiningMode::All)
+                visitor(itemset, supports[i]);
+
+            // Every itemset has to be visited when mining MFIs or closed FIs, even without a projection
+            const bool hasLater = i + 1 < extensions.size();
+            const Projection projected = hasLater ? project(projection, extensions[i]) : Projection();
+            if (mode != MiningMode::All)
+            {
+                later.assign(extensions.begin() + static_cast<std::ptrdiff_t>(i) + 1, extensions.end());
+                extend(projected, &later, supports[i], narrow(focus, first, extensions[i]));
+            }
+            else if (!projected.empty())
+            {
+                later.assign(extensions.begin() + static_cast<std::ptrdiff_t>(i) + 1, extensions.end());
+                extend(projected, &later, supports[i], Focus());
+            }
+
+            itemset.pop_back();
+        }
+        closure.resize(closed);
+    }
+
+public:
+    RowMiner(const Graph &graph, const std::vector<uint32_t> &ranks, const std::atomic<size_t> &minSupport,
+             const FiVisitor &visitor, const MiningMode mode) :
+        graph(graph), ranks(ranks), minSupport(minSupport), visitor(visitor), mode(mode),
+        buffers(scratch(graph.nodes.size())) {}
+
+    /**
+     * \brief Mines the FIs of a row
+     * \param row The from item of the row
+     * \param rowEdges The indices of the edges of the row
+     */
+    void mine(const ItemId row, std::vector<size_t> rowEdges)
+    {
+        label = row;
+        if (!graph.CLM.hasRow(label))
+            return;
+
+        // Dense rows are scanned against the minimum support in one pass, sparse rows are looked up cell by cell
+        dense = graph.CLM.scanRow(label, threshold(), frequent);
+        if (!isFrequent(label))
+            return;
+
+        const size_t rowSupport = graph.CLM.get(label, label);
+        itemset.assign(1, label);
+        if (mode == MiningMode::All)
+            visitor(itemset, rowSupport);
+
+        // The edges of a to item are the projection of the row onto the pair of the row and the to item
+        std::sort(rowEdges.begin(), rowEdges.end(), [this](const size_t lhs, const size_t rhs)
+        {
+            return ranks[graph.edges[lhs].to] < ranks[graph.edges[rhs].to];
+        });
+
+        // The to items found in every transaction of the row form its closure
+        closure.clear();
+        if (mode == MiningMode::Closed)
+        {
+            for (const size_t edge : rowEdges)
+            {
+                const ItemId major = graph.edges[edge].to;
+                if ((closure.empty() || closure.back() != major) && graph.CLM.get(label, major) == rowSupport)
+                    closure.push_back(major);
+            }
+
+            joined.assign(itemset.begin(), itemset.end());
+            joined.insert(joined.end(), closure.begin(), closure.end());
+            report(joined, rowSupport);
+        }
+
+        Projection projection;
+        for (size_t begin = 0, end; begin < rowEdges.size(); begin = end)
+        {
+            const ItemId major = graph.edges[rowEdges[begin]].to;
+            for (end = begin; end < rowEdges.size() && graph.edges[rowEdges[end]].to == major; ++end)
+            {
+            }
+
+            if (!isFrequent(major) || std::ranges::find(closure, major) != closure.end())
+                continue;
+
+            itemset.push_back(major);
+            const size_t support = graph.CLM.get(label, major);
+            if (mode == MiningMode::All)
+                visitor(itemset, support);
+
+            projection.clear();
+            for (size_t i = begin; i < end; ++i)
+            {
+                const SuffixId extraNodes = graph.edges[rowEdges[i]].extraNodes;
+                if (extraNodes != SuffixPool::empty)
+                {
+                    projection.emplace_back(extraNodes, graph.edgeWeight(rowEdges[i]));
+                }
+            }
+            mergeProjection(projection);
+
+            // Every itemset reported for the row contains the row, so the focus of the pair is every one holding the
+            // to item
+            if (mode != MiningMode::All)
+            {
+                extend(projection, nullptr, support, narrow({}, 0, major));
+            }
+            else if (!projection.empty())
+            {
+                extend(projection, nullptr, support, Focus());
+            }
+            itemset.pop_back();
+        }
+
+        if (mode == MiningMode::Maximal && reported.empty())
+        {
+            report(itemset, rowSupport);
+        }
+    }
+};
+
+void Graph::mineRows(const std::vector<ItemId> &order, const std::vector<uint32_t> &ranks,
+                     const std::atomic<size_t> &minSupport, const size_t threads, const MiningMode mode,
+                     const std::function<FiVisitor(size_t)> &rowVisitor, const std::function<void(size_t)> &rowMined)
+{
+    // The CLM is kept current as transactions are processed, it only has to be rebuilt after a load or a reshape that
+    // could not carry it over
+    if (!clmCurrent)
+    {
+        rebuildClm(threads);
+    }
+
+    std::vector<size_t> rowOffsets;
+    std::vector<size_t> rowEdges;
+    groupEdgesByRow(rowOffsets, rowEdges);
+
+    const auto mineRow = [&](const size_t i)
+    {
+        const FiVisitor visitor = rowVisitor(i);
+        RowMiner(*this, ranks, minSupport, visitor, mode)
+                .mine(order[i], {rowEdges.begin() + static_cast<std::ptrdiff_t>(rowOffsets[order[i]]),
+                                 rowEdges.begin() + static_cast<std::ptrdiff_t>(rowOffsets[order[i] + 1])});
+
+        if (rowMined)
+        {
+            rowMined(i);
+        }
+    };
+
+    if (threads <= 1)
+    {
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            mineRow(i);
+        }
+    }
+    else
+    {
+        ThreadPool pool(threads);
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            pool.submit([&mineRow, i] { mineRow(i); });
+        }
+        pool.wait();
+    }
+}
+
+void Graph::visitFIs(const int minSup, const FiVisitor &visitor, const size_t threads, const MiningMode mode)
+{
+    const std::atomic<size_t> minSupport = static_cast<size_t>(minSup);
+
+    const std::vector<ItemId> order = dictionary.sorted();
+    std::vector<uint32_t> ranks(order.size());
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        ranks[order[i]] = static_cast<uint32_t>(i);
+    }
+
+    // Mined on the calling thread the rows finish in order, so every FI can go straight to the visitor
+    if (threads <= 1 && mode == MiningMode::All)
+    {
+        mineRows(order, ranks, minSupport, threads, mode, [&visitor](size_t) { return visitor; });
+        return;
+    }
+
+    // Otherwise every row is mined into its own buffer that is handed out once the rows before it were, which keeps
+    // the order the same for any thread count. Rows of every FI are freed once handed out, the MFIs and closed FIs are
+    // kept as the later rows are checked against them
+    std::vector<FrequentItemsets> rowFIs(order.size());
+    std::vector<bool> mined(order.size(), false);
+    size_t next = 0;
+    std::mutex mutex;
+
+    const RankOrder rankOrder{ranks};
+    std::vector<std::vector<ItemsetView>> postings(mode == MiningMode::All ? 0 : order.size());
+    std::vector<ItemsetView> views;
+    std::vector<bool> contained;
+    const auto handOut = [&](FrequentItemsets &row, const ItemId label)
+    {
+        if (mode == MiningMode::All)
+        {
+            for (size_t i = 0; i < row.size(); ++i)
+            {
+                visitor(row.items(i), row.support(i));
+            }
+            row = FrequentItemsets();
+            return;
+        }
+
+        // An MFI or closed FI of a row can still be contained in one of an earlier row, for closed FIs one of the same
+        // support, which only shows once the rows are joined. Such an itemset holds the row, so only the itemsets
+        // holding the row are compared with it
+        views.clear();
+        for (size_t i = 0; i < row.size(); ++i)
+        {
+            views.push_back({row.items(i), row.support(i)});
+        }
+        std::ranges::sort(views, [rankOrder](const ItemsetView &lhs, const ItemsetView &rhs)
+        {
+            return std::ranges::lexicographical_compare(lhs.items, rhs.items, rankOrder);
+        });
+
+        contained.assign(views.size(), false);
+        if (!views.empty())
+        {
+            markContained(views, 0, views.size(), 1, postings[label], rankOrder, mode == MiningMode::Closed,
+                          contained);
+        }
+
+        for (size_t i = 0; i < views.size(); ++i)
+        {
+            if (contained[i])
+                continue;
+
+            for (const ItemId item : views[i].items)
+            {
+                postings[item].push_back(views[i]);
+            }
+            visitor(views[i].items, views[i].support);
+        }
+    };
+
+    mineRows(order, ranks, minSupport, threads, mode, [&rowFIs](const size_t i)
+    {
+        return [&FIs = rowFIs[i]](const std::span<const ItemId> items, const size_t support)
+        {
+            FIs.add(items, support);
+        };
+    }, [&](const size_t i)
+    {
+        std::lock_guard lock(mutex);
+        for (mined[i] = true; next < order.size() && mined[next]; ++next)
+        {
+            handOut(rowFIs[next], order[next]);
+        }
+    });
+}
+
+FrequentItemsets Graph::useCLM_Miner(const int minSup, const size_t threads, const MiningMode mode)
+{
+    FrequentItemsets FIs;
+    visitFIs(minSup, [&FIs](const std::span<const ItemId> items, const size_t support)
+    {
+        FIs.add(items, support);
+    }, threads, mode);
+
+    return FIs;
+}
+
+void Graph::visitTopK(const size_t k, const FiVisitor &visitor, const int minSup, const size_t threads)
+{
+    if (k == 0)
+        return;
+
+    if (!clmCurrent)
+    {
+        rebuildClm(threads);
+    }
+
+    const std::vector<ItemId> order = dictionary.sorted();
+    std::vector<uint32_t> ranks(order.size());
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        ranks[order[i]] = static_cast<uint32_t>(i);
+    }
+
+    // The supports of the single items and the pairs are the major cells of the CLM, so the search can start from the
+    // k-th best of them rather than from the minimum support
+    std::priority_queue<size_t, std::vector<size_t>, std::greater<>> seeds;
+    for (const ItemId item : order)
+    {
+        CLM.forEachCell(item, [&seeds, k](const ItemId, const ItemId minor, const size_t count)
+        {
+            if (minor != ClmMatrix::majorCell)
+                return;
+
+            seeds.push(count);
+            if (seeds.size() > k)
+                seeds.pop();
+        });
+    }
+
+    std::atomic<size_t> minSupport = static_cast<size_t>(minSup);
+    if (seeds.size() == k && seeds.top() > minSupport)
+    {
+        minSupport = seeds.top();
+    }
+
+    // Rows of frequent items hold the FIs of the highest support, mining them first raises the minimum support soonest
+    std::vector<ItemId> rows = order;
+    std::ranges::stable_sort(rows, [this](const ItemId lhs, const ItemId rhs)
+    {
+        return CLM.get(lhs, lhs) > CLM.get(rhs, rhs);
+    });
+
+    TopK best(k, RankOrder{ranks}, minSupport);
+    const FiVisitor offer = [&best](const std::span<const ItemId> items, const size_t support)
+    {
+        best.offer(items, support);
+    };
+    mineRows(rows, ranks, minSupport, threads, MiningMode::All, [&offer](size_t) { return offer; });
+
+    for (const Itemset &itemset : best.take())
+    {
+        visitor(itemset.items, itemset.support);
+    }
+}
+
+FrequentItemsets Graph::useTopK_Miner(const size_t k, const int minSup, const size_t threads)
+{
+    FrequentItemsets FIs;
+    visitTopK(k, [&FIs](const std::span<const ItemId> items, const size_t support)
+    {
+        FIs.add(items, support);
+    }, minSup, threads);
+
+    return FIs;
+}
@@ -0,0 +1,381 @@
+#include "../include/Graph.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    // Snapshot layout, all sections follow the header in this order and start on an 8 byte boundary. The suffix trie,
+    // the edges and the dense CLM are the in-memory arrays of the graph, so loading copies them back as they are:
+    //  tokenOffsets   uint64_t[itemCount + 1], token i is tokenData[tokenOffsets[i], tokenOffsets[i + 1])
+    //  tokenData      char[tokenBytes]
+    //  occurrences    uint64_t[itemCount], indexed by item ID
+    //  suffixNodes    SuffixPool::Node[suffixNodeCount], the trie nodes indexed by suffix ID
+    //  suffixSlots    SuffixId[suffixSlotCount], the hash of the trie nodes
+    //  edges          Graph::Edge[edgeCount]
+    //  wideWeights    WideWeight[wideWeightCount], the weights of the edges that outgrew their occurrence
+    //  clmRows        uint8_t[itemCount], whether every row of the CLM exists, only if it was current
+    //  clmDense       char[clmDenseBytes], the cells of a dense CLM clmCellBytes wide each
+    //  clmRowCells    uint64_t[itemCount], the number of cells of every sparse row, only for a current sparse CLM
+    //  clmCells       ClmMatrix::SparseCell[clmCellCount], the non-zero cells of a sparse CLM row by row in key order
+    constexpr char snapshotMagic[8] = {'C', 'L', 'M', 'S', 'N', 'A', 'P', '\0'};
+    constexpr uint32_t snapshotVersion = 3;
+    constexpr uint32_t snapshotByteOrder = 0x01020304;
+
+    struct SnapshotHeader {
+      char magic[8]{};
+      uint32_t version{};
+      uint32_t byteOrder{};
+      uint64_t maxNodes{};
+      uint32_t clmLayout{};
+      uint32_t clmCurrent{};
+      uint64_t itemCount{};
+      uint64_t tokenBytes{};
+      uint64_t suffixNodeCount{};
+      uint64_t suffixSlotCount{};
+      uint64_t edgeCount{};
+      uint64_t wideWeightCount{};
+      uint32_t clmCellBytes{};
+      uint32_t padding{};
+      uint64_t clmDenseBytes{};
+      uint64_t clmCellCount{};
+    };
+
+    struct WideWeight {
+      uint64_t edge{};
+      uint64_t weight{};
+    };
+
+    size_t padding(const size_t bytes)
+    {
+        return (8 - bytes % 8) % 8;
+    }
+
+    template <typename Section>
+    void writeSection(std::ostream &stream, const Section &section)
+    {
+        const size_t bytes = std::ranges::size(section) * sizeof(std::ranges::range_value_t<Section>);
+        stream.write(reinterpret_cast<const char *>(std::ranges::data(section)), static_cast<std::streamsize>(bytes));
+
+        constexpr char zeros[8]{};
+        stream.write(zeros, static_cast<std::streamsize>(padding(bytes)));
+    }
+
+    // A read-only private mapping of a whole file
+    class MappedFile
+    {
+        int fd = -1;
+        void *data = MAP_FAILED;
+        size_t size = 0;
+
+    public:
+        explicit MappedFile(const std::string &path)
+        {
+            fd = open(path.c_str(), O_RDONLY);
+            if (fd == -1)
+            {
+                throw std::runtime_error("Failed to open snapshot " + path);
+            }
+
+            struct stat info{};
+            if (fstat(fd, &info) == -1)
+            {
+                close(fd);
+                throw std::runtime_error("Failed to stat snapshot " + path);
+            }
+            size = static_cast<size_t>(info.st_size);
+
+            if (size > 0)
+            {
+                data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            }
+            if (data == MAP_FAILED)
+            {
+                close(fd);
+                throw std::runtime_error("Failed to map snapshot " + path);
+            }
+            madvise(data, size, MADV_SEQUENTIAL);
+        }
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        ~MappedFile()
+        {
+            munmap(data, size);
+            close(fd);
+        }
+
+        [[nodiscard]] const char *bytes() const noexcept
+        {
+            return static_cast<const char *>(data);
+        }
+
+        [[nodiscard]] size_t length() const noexcept
+        {
+            return size;
+        }
+    };
+
+    // Walks the sections of a mapped snapshot checking that every section lies inside the file
+    class SectionReader
+    {
+        const char *cursor;
+        const char *end;
+
+    public:
+        SectionReader(const char *begin, const size_t length) : cursor(begin), end(begin + length) {}
+
+        template <typename T>
+        const T *next(const uint64_t count)
+        {
+            if (count > static_cast<uint64_t>(end - cursor) / sizeof(T))
+            {
+                throw std::runtime_error("Snapshot is truncated");
+            }
+
+            const auto *section = reinterpret_cast<const T *>(cursor);
+            const size_t bytes = count * sizeof(T);
+            cursor += std::min(bytes + padding(bytes), static_cast<size_t>(end - cursor));
+
+            return section;
+        }
+    };
+}
+
+void Graph::writeSnapshot(std::ostream &stream) const
+{
+    static_assert(std::is_trivially_copyable_v<Edge> && sizeof(Edge) == 16);
+    static_assert(std::is_trivially_copyable_v<SuffixPool::Node> && sizeof(SuffixPool::Node) == 8);
+    static_assert(std::is_trivially_copyable_v<ClmMatrix::SparseCell> && sizeof(ClmMatrix::SparseCell) == 16);
+
+    SnapshotHeader header;
+    std::memcpy(header.magic, snapshotMagic, sizeof(snapshotMagic));
+    header.version = snapshotVersion;
+    header.byteOrder = snapshotByteOrder;
+    header.maxNodes = maxNodes;
+    header.clmLayout = static_cast<uint32_t>(clmLayout);
+    header.clmCurrent = clmCurrent;
+    header.itemCount = nodes.size();
+
+    std::vector<uint64_t> tokenOffsets{0};
+    std::vector<char> tokenData;
+    std::vector<uint64_t> occurrences;
+    for (const auto &[label, occurrence] : nodes)
+    {
+        const std::string &token = dictionary.token(label);
+        tokenData.insert(tokenData.end(), token.begin(), token.end());
+        tokenOffsets.push_back(tokenData.size());
+        occurrences.push_back(occurrence);
+    }
+    header.tokenBytes = tokenData.size();
+
+    const std::span<const SuffixPool::Node> suffixNodes = suffixes.getNodes();
+    const std::span<const SuffixId> suffixSlots = suffixes.getSlots();
+    header.suffixNodeCount = suffixNodes.size();
+    header.suffixSlotCount = suffixSlots.size();
+    header.edgeCount = edges.size();
+
+    // Sorted so that the same graph always gives the same file
+    std::vector<WideWeight> wideWeights;
+    for (const auto &[edge, weight] : wideEdgeWeights)
+    {
+        wideWeights.push_back({edge, weight});
+    }
+    std::ranges::sort(wideWeights, {}, &WideWeight::edge);
+    header.wideWeightCount = wideWeights.size();
+
+    // Sparse rows are only counted here, their cells are streamed row by row after the header
+    const bool sparse = clmCurrent && CLM.getLayout() == ClmMatrix::Layout::Sparse;
+    std::vector<uint8_t> clmRows;
+    std::span<const char> clmDense;
+    std::vector<uint64_t> clmRowCells;
+    if (clmCurrent)
+    {
+        for (const auto &[label, occurrence] : nodes)
+        {
+            clmRows.push_back(CLM.hasRow(label));
+            if (sparse)
+            {
+                clmRowCells.push_back(CLM.sparseRowSize(label));
+                header.clmCellCount += clmRowCells.back();
+            }
+        }
+
+        if (!sparse)
+        {
+            clmDense = CLM.denseBytes();
+            header.clmCellBytes = static_cast<uint32_t>(CLM.getCellBytes());
+        }
+    }
+    header.clmDenseBytes = clmDense.size();
+
+    stream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    writeSection(stream, tokenOffsets);
+    writeSection(stream, tokenData);
+    writeSection(stream, occurrences);
+    writeSection(stream, suffixNodes);
+    writeSection(stream, suffixSlots);
+    writeSection(stream, edges);
+    writeSection(stream, wideWeights);
+    writeSection(stream, clmRows);
+    writeSection(stream, clmDense);
+    writeSection(stream, clmRowCells);
+
+    // The cells are 16 bytes wide, so the rows need no padding between them
+    std::vector<ClmMatrix::SparseCell> clmCells;
+    for (size_t row = 0; sparse && row < nodes.size(); ++row)
+    {
+        CLM.sparseRowCells(static_cast<ItemId>(row), clmCells);
+        writeSection(stream, clmCells);
+    }
+}
+
+Graph Graph::loadSnapshot(const std::string &path)
+{
+    const MappedFile file(path);
+    SectionReader reader(file.bytes(), file.length());
+
+    const SnapshotHeader &header = *reader.next<SnapshotHeader>(1);
+    if (std::memcmp(header.magic, snapshotMagic, sizeof(snapshotMagic)) != 0)
+    {
+        throw std::runtime_error("Not a snapshot file " + path);
+    }
+    if (header.version != snapshotVersion || header.byteOrder != snapshotByteOrder)
+    {
+        throw std::runtime_error("Unsupported snapshot version or byte order " + path);
+    }
+    if (header.clmLayout > static_cast<uint32_t>(ClmMatrix::Layout::Sparse))
+    {
+        throw std::runtime_error("Snapshot has an unknown CLM layout " + path);
+    }
+    if (header.maxNodes < header.itemCount || header.itemCount >= ItemDictionary::npos)
+    {
+        throw std::runtime_error("Snapshot has fewer CLM columns than items " + path);
+    }
+
+    const auto *tokenOffsets = reader.next<uint64_t>(header.itemCount + 1);
+    const auto *tokenData = reader.next<char>(header.tokenBytes);
+    const auto *occurrences = reader.next<uint64_t>(header.itemCount);
+    const auto *suffixNodes = reader.next<SuffixPool::Node>(header.suffixNodeCount);
+    const auto *suffixSlots = reader.next<SuffixId>(header.suffixSlotCount);
+    const auto *edgeRecords = reader.next<Edge>(header.edgeCount);
+    const auto *wideWeights = reader.next<WideWeight>(header.wideWeightCount);
+    const auto *clmRows = reader.next<uint8_t>(header.clmCurrent ? header.itemCount : 0);
+    const auto *clmDense = reader.next<char>(header.clmDenseBytes);
+    const bool sparse = header.clmCurrent && header.clmDenseBytes == 0;
+    const auto *clmRowCells = reader.next<uint64_t>(sparse ? header.itemCount : 0);
+    const auto *clmCells = reader.next<ClmMatrix::SparseCell>(header.clmCellCount);
+
+    // Without its CLM the graph is sized by its items, the maxNodes of the header only sizes a dense CLM whose cells
+    // are in the file
+    Graph graph(header.clmCurrent && !sparse ? header.maxNodes : std::max<uint64_t>(header.itemCount, 1));
+    graph.clmLayout = static_cast<ClmMatrix::Layout>(header.clmLayout);
+
+    // Tokens are stored in ID order, so interning them in order restores the same IDs
+    graph.nodes.reserve(header.itemCount);
+    for (uint64_t i = 0; i < header.itemCount; ++i)
+    {
+        if (tokenOffsets[i] > tokenOffsets[i + 1] || tokenOffsets[i + 1] > header.tokenBytes)
+        {
+            throw std::runtime_error("Snapshot has an invalid token table " + path);
+        }
+
+        // Tokens are always written as valid UTF-8, the dictionary would rewrite any other token and break the order of
+        // the edges
+        const std::string_view token(tokenData + tokenOffsets[i], tokenOffsets[i + 1] - tokenOffsets[i]);
+        if (!ItemDictionary::isUtf8(token))
+        {
+            throw std::runtime_error("Snapshot has a token that is not valid UTF-8 " + path);
+        }
+
+        const ItemId id = graph.internItem(token);
+        if (id != i)
+        {
+            throw std::runtime_error("Snapshot has a duplicate token " + path);
+        }
+        graph.nodes[id].occurrence = occurrences[i];
+    }
+
+    try
+    {
+        graph.suffixes.assign({suffixNodes, header.suffixNodeCount}, {suffixSlots, header.suffixSlotCount},
+                              header.itemCount);
+    } catch (const std::invalid_argument &error)
+    {
+        throw std::runtime_error(error.what() + (" " + path));
+    }
+
+    const auto validId = [&header](const uint32_t id) { return id < header.itemCount; };
+    graph.edges.assign(edgeRecords, edgeRecords + header.edgeCount);
+    size_t wideEdges = 0;
+    for (const Edge &edge : graph.edges)
+    {
+        if (!validId(edge.from) || !validId(edge.to) || edge.extraNodes >= header.suffixNodeCount)
+        {
+            throw std::runtime_error("Snapshot has an invalid edge " + path);
+        }
+        wideEdges += edge.occurrence == wideOccurrence;
+    }
+
+    // Every edge that outgrew its occurrence needs exactly one wide weight
+    for (uint64_t i = 0; i < header.wideWeightCount; ++i)
+    {
+        const auto &[edge, weight] = wideWeights[i];
+        if (edge >= header.edgeCount || graph.edges[edge].occurrence != wideOccurrence ||
+            !graph.wideEdgeWeights.emplace(edge, weight).second)
+        {
+            throw std::runtime_error("Snapshot has an invalid wide edge weight " + path);
+        }
+    }
+    if (wideEdges != header.wideWeightCount)
+    {
+        throw std::runtime_error("Snapshot is missing a wide edge weight " + path);
+    }
+    graph.edgeIndexCurrent = false;
+
+    if (!header.clmCurrent)
+    {
+        graph.clmCurrent = false;
+        return graph;
+    }
+
+    try
+    {
+        graph.CLM = sparse ? ClmMatrix(ClmMatrix::Layout::Sparse, graph.maxNodes)
+                           : ClmMatrix::fromDenseBytes(header.maxNodes, header.clmCellBytes,
+                                                       {clmDense, header.clmDenseBytes});
+
+        // Every sparse row sizes its hash once for the cells counted for it
+        uint64_t clmCellOffset = 0;
+        for (uint64_t i = 0; i < header.itemCount; ++i)
+        {
+            const uint64_t cells = sparse ? clmRowCells[i] : 0;
+            if ((!clmRows[i] && cells > 0) || cells > header.clmCellCount - clmCellOffset)
+            {
+                throw std::invalid_argument("Snapshot has an invalid CLM row");
+            }
+
+            if (sparse && clmRows[i])
+                graph.CLM.assignSparseRow(static_cast<ItemId>(i), {clmCells + clmCellOffset, cells}, header.itemCount);
+            else if (clmRows[i])
+                graph.CLM.ensureRow(static_cast<ItemId>(i));
+            clmCellOffset += cells;
+        }
+        if (clmCellOffset != header.clmCellCount)
+        {
+            throw std::invalid_argument("Snapshot has CLM cells outside of its rows");
+        }
+    } catch (const std::invalid_argument &error)
+    {
+        throw std::runtime_error(error.what() + (" " + path));
+    }
+    graph.clmCurrent = true;
+
+    return graph;
+}
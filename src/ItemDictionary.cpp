@@ -0,0 +1,132 @@
+#include "../include/ItemDictionary.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+size_t ItemDictionary::utf8Length(const std::string_view text) noexcept
+{
+    if (text.empty())
+        return 0;
+
+    const auto byte = [text](const size_t i) { return static_cast<unsigned char>(text[i]); };
+    const unsigned char lead = byte(0);
+    if (lead < 0x80)
+        return 1;
+
+    // The lead byte gives the length, overlong encodings, surrogates and code points beyond U+10FFFF are invalid, which
+    // narrows the range of the second byte for some lead bytes
+    size_t length = 0;
+    unsigned char low = 0x80;
+    unsigned char high = 0xBF;
+    if (lead >= 0xC2 && lead <= 0xDF)
+    {
+        length = 2;
+    }
+    else if (lead >= 0xE0 && lead <= 0xEF)
+    {
+        length = 3;
+        low = lead == 0xE0 ? 0xA0 : 0x80;
+        high = lead == 0xED ? 0x9F : 0xBF;
+    }
+    else if (lead >= 0xF0 && lead <= 0xF4)
+    {
+        length = 4;
+        low = lead == 0xF0 ? 0x90 : 0x80;
+        high = lead == 0xF4 ? 0x8F : 0xBF;
+    }
+    else
+    {
+        return 0;
+    }
+
+    if (text.length() < length || byte(1) < low || byte(1) > high)
+        return 0;
+    for (size_t i = 2; i < length; ++i)
+    {
+        if ((byte(i) & 0xC0) != 0x80)
+            return 0;
+    }
+
+    return length;
+}
+
+bool ItemDictionary::isUtf8(const std::string_view text) noexcept
+{
+    for (size_t offset = 0; offset < text.length();)
+    {
+        const size_t length = utf8Length(text.substr(offset));
+        if (length == 0)
+            return false;
+        offset += length;
+    }
+
+    return true;
+}
+
+ItemId ItemDictionary::intern(const std::string_view token)
+{
+    if (!isUtf8(token))
+    {
+        std::string valid;
+        valid.reserve(2 * token.length());
+        for (size_t offset = 0; offset < token.length();)
+        {
+            if (const size_t length = utf8Length(token.substr(offset)); length > 0)
+            {
+                valid.append(token.substr(offset, length));
+                offset += length;
+                continue;
+            }
+
+            // Every byte that does not start a UTF-8 character is at least 0x80, so its Latin-1 character takes two bytes
+            const auto byte = static_cast<unsigned char>(token[offset++]);
+            valid += static_cast<char>(0xC0 | byte >> 6);
+            valid += static_cast<char>(0x80 | (byte & 0x3F));
+        }
+
+        return intern(valid);
+    }
+
+    if (const auto it = ids.find(token); it != ids.end())
+    {
+        return it->second;
+    }
+
+    const auto id = static_cast<ItemId>(tokens.size());
+    tokens.emplace_back(token);
+    ids.emplace(tokens.back(), id);
+
+    return id;
+}
+
+const std::string &ItemDictionary::token(const ItemId id) const noexcept
+{
+    return tokens[id];
+}
+
+size_t ItemDictionary::size() const noexcept
+{
+    return tokens.size();
+}
+
+bool ItemDictionary::precedes(const ItemId lhs, const ItemId rhs) const noexcept
+{
+    const std::string &lhsToken = tokens[lhs];
+    const std::string &rhsToken = tokens[rhs];
+
+    if (lhsToken.length() != rhsToken.length())
+    {
+        return lhsToken.length() < rhsToken.length();
+    }
+
+    return lhsToken < rhsToken;
+}
+
+std::vector<ItemId> ItemDictionary::sorted() const
+{
+    std::vector<ItemId> order(tokens.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [this](const ItemId lhs, const ItemId rhs) { return precedes(lhs, rhs); });
+
+    return order;
+}
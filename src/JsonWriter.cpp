@@ -0,0 +1,109 @@
+#include "../include/JsonWriter.hpp"
+#include "../include/json.hpp"
+
+#include <algorithm>
+#include <charconv>
+
+// PRIVATE FUNCTIONS
+
+void JsonWriter::flushIfFull()
+{
+    if (buffer.size() >= blockSize)
+    {
+        flush();
+    }
+}
+
+
+// PUBLIC FUNCTIONS
+
+JsonWriter::JsonWriter(std::ostream &stream) : stream(stream)
+{
+    buffer.reserve(blockSize + blockSize / 4);
+}
+
+JsonWriter::~JsonWriter()
+{
+    flush();
+}
+
+void JsonWriter::raw(const char c)
+{
+    buffer += c;
+    flushIfFull();
+}
+
+void JsonWriter::raw(const std::string_view str)
+{
+    buffer += str;
+    flushIfFull();
+}
+
+void JsonWriter::string(const std::string_view str)
+{
+    buffer += '"';
+    stringPart(str);
+    buffer += '"';
+    flushIfFull();
+}
+
+void JsonWriter::stringPart(const std::string_view part)
+{
+    // Anything beyond ASCII is left to nlohmann, which validates the UTF-8 and escapes it the same way as a dump
+    if (std::ranges::any_of(part, [](const char c) { return static_cast<unsigned char>(c) >= 0x80; }))
+    {
+        const std::string dumped = nlohmann::json(std::string(part)).dump();
+        buffer.append(dumped, 1, dumped.size() - 2);
+        flushIfFull();
+        return;
+    }
+
+    for (const char c : part)
+    {
+        switch (c)
+        {
+            case '"': buffer += "\\\""; break;
+            case '\\': buffer += "\\\\"; break;
+            case '\b': buffer += "\\b"; break;
+            case '\f': buffer += "\\f"; break;
+            case '\n': buffer += "\\n"; break;
+            case '\r': buffer += "\\r"; break;
+            case '\t': buffer += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    constexpr char hex[] = "0123456789abcdef";
+                    buffer += "\\u00";
+                    buffer += hex[c >> 4];
+                    buffer += hex[c & 0xF];
+                }
+                else
+                {
+                    buffer += c;
+                }
+        }
+    }
+    flushIfFull();
+}
+
+void JsonWriter::number(const size_t value)
+{
+    char digits[20];
+    const auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    buffer.append(digits, result.ptr);
+    flushIfFull();
+}
+
+void JsonWriter::null()
+{
+    raw("null");
+}
+
+void JsonWriter::flush()
+{
+    if (buffer.empty())
+        return;
+
+    stream.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    buffer.clear();
+}
@@ -0,0 +1,129 @@
+#include "../include/SuffixPool.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+// PRIVATE FUNCTIONS
+
+size_t SuffixPool::hash(const ItemId item, const SuffixId next) noexcept
+{
+    // Multiplicative hash of the packed pair, the high bits are the best mixed
+    const uint64_t key = static_cast<uint64_t>(item) << 32 | next;
+    return static_cast<size_t>((key * 0x9E3779B97F4A7C15ULL) >> 17);
+}
+
+void SuffixPool::grow()
+{
+    slots.assign(slots.size() * 2, freeSlot);
+    const size_t mask = slots.size() - 1;
+
+    // The empty suffix is never looked up, so it is not in the table
+    for (SuffixId id = 1; id < nodes.size(); ++id)
+    {
+        size_t slot = hash(nodes[id].item, nodes[id].next) & mask;
+        while (slots[slot] != freeSlot)
+        {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = id;
+    }
+}
+
+
+// PUBLIC FUNCTIONS
+
+SuffixPool::SuffixPool() : nodes{{ItemDictionary::npos, empty}}, slots(16, freeSlot) {}
+
+SuffixId SuffixPool::extend(const ItemId item, const SuffixId next)
+{
+    const size_t mask = slots.size() - 1;
+    size_t slot = hash(item, next) & mask;
+    for (; slots[slot] != freeSlot; slot = (slot + 1) & mask)
+    {
+        const Node &node = nodes[slots[slot]];
+        if (node.item == item && node.next == next)
+        {
+            return slots[slot];
+        }
+    }
+
+    if (nodes.size() >= freeSlot)
+    {
+        throw std::length_error("Too many distinct suffixes");
+    }
+
+    const auto id = static_cast<SuffixId>(nodes.size());
+    nodes.emplace_back(item, next);
+    slots[slot] = id;
+
+    if (nodes.size() * 2 > slots.size())
+    {
+        grow();
+    }
+
+    return id;
+}
+
+SuffixId SuffixPool::intern(const std::span<const ItemId> suffix)
+{
+    SuffixId id = empty;
+    for (auto it = suffix.rbegin(); it != suffix.rend(); ++it)
+    {
+        id = extend(*it, id);
+    }
+
+    return id;
+}
+
+SuffixPool::Suffix SuffixPool::get(const SuffixId id) const noexcept
+{
+    return {this, id};
+}
+
+size_t SuffixPool::size() const noexcept
+{
+    return nodes.size();
+}
+
+std::span<const SuffixPool::Node> SuffixPool::getNodes() const noexcept
+{
+    return nodes;
+}
+
+std::span<const SuffixId> SuffixPool::getSlots() const noexcept
+{
+    return slots;
+}
+
+void SuffixPool::assign(const std::span<const Node> nodes, const std::span<const SuffixId> slots, const size_t itemCount)
+{
+    // The empty suffix comes first and every other suffix is made of an item and a suffix interned before it
+    if (nodes.empty() || nodes.size() >= freeSlot || nodes[0].next != empty)
+    {
+        throw std::invalid_argument("Suffix pool has no empty suffix");
+    }
+    for (size_t id = 1; id < nodes.size(); ++id)
+    {
+        if (nodes[id].item >= itemCount || nodes[id].next >= id)
+        {
+            throw std::invalid_argument("Suffix pool has an invalid node");
+        }
+    }
+
+    // Lookups probe until a free slot, so the hash has to stay a power of two in size and at most half full
+    if (slots.size() < 16 || (slots.size() & (slots.size() - 1)) != 0 || nodes.size() * 2 > slots.size())
+    {
+        throw std::invalid_argument("Suffix pool has an invalid hash size");
+    }
+    if (!std::ranges::all_of(slots, [&](const SuffixId id)
+    {
+        return id == freeSlot || (id != empty && id < nodes.size());
+    }))
+    {
+        throw std::invalid_argument("Suffix pool has an invalid hash slot");
+    }
+
+    this->nodes.assign(nodes.begin(), nodes.end());
+    this->slots.assign(slots.begin(), slots.end());
+}
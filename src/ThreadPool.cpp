@@ -0,0 +1,122 @@
+#include "../include/ThreadPool.hpp"
+
+#include <algorithm>
+#include <utility>
+
+// PRIVATE FUNCTIONS
+
+bool ThreadPool::take(const size_t self, std::function<void()> &task)
+{
+    for (size_t i = 0; i < queues.size(); ++i)
+    {
+        Queue &queue = *queues[(self + i) % queues.size()];
+        std::unique_lock lock(queue.mutex);
+        if (queue.tasks.empty())
+            continue;
+
+        // The own queue is used as a stack, stealing takes the oldest task which tends to be the largest remaining
+        if (i == 0)
+        {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        else
+        {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+        lock.unlock();
+
+        std::lock_guard counters(mutex);
+        --queued;
+        return true;
+    }
+
+    return false;
+}
+
+void ThreadPool::work(const size_t self)
+{
+    std::function<void()> task;
+    while (true)
+    {
+        if (take(self, task))
+        {
+            try
+            {
+                task();
+            } catch (...)
+            {
+                std::lock_guard lock(mutex);
+                if (!failure)
+                    failure = std::current_exception();
+            }
+            task = nullptr;
+
+            std::lock_guard lock(mutex);
+            if (--unfinished == 0)
+                idle.notify_all();
+            continue;
+        }
+
+        std::unique_lock lock(mutex);
+        wake.wait(lock, [this] { return stopping || queued > 0; });
+        if (stopping && queued == 0)
+            return;
+    }
+}
+
+
+// PUBLIC FUNCTIONS
+
+ThreadPool::ThreadPool(const size_t threads)
+{
+    const size_t count = std::max<size_t>(threads, 1);
+    for (size_t i = 0; i < count; ++i)
+    {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    for (size_t i = 0; i < count; ++i)
+    {
+        workers.emplace_back([this, i] { work(i); });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    workers.clear();
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+    // Count the task before it is visible so that a worker taking it never sees the counters underflow
+    size_t index;
+    {
+        std::lock_guard lock(mutex);
+        ++queued;
+        ++unfinished;
+        index = nextQueue++ % queues.size();
+    }
+
+    {
+        std::lock_guard lock(queues[index]->mutex);
+        queues[index]->tasks.push_back(std::move(task));
+    }
+    wake.notify_one();
+}
+
+void ThreadPool::wait()
+{
+    std::unique_lock lock(mutex);
+    idle.wait(lock, [this] { return unfinished == 0; });
+
+    if (failure)
+    {
+        std::rethrow_exception(std::exchange(failure, nullptr));
+    }
+}
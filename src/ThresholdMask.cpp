@@ -0,0 +1,223 @@
+#include "../include/ThresholdMask.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CLM_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    template <typename T>
+    using Kernel = void (*)(const T *cells, size_t count, T threshold, uint64_t *words);
+
+    // Every kernel only ORs bits into words, which are zeroed beforehand, the vector kernels leave the cells after
+    // their last whole block to the scalar loop
+    template <typename T>
+    void scanScalar(const T *cells, const size_t first, const size_t count, const T threshold, uint64_t *words)
+    {
+        for (size_t i = first; i < count; ++i)
+        {
+            words[i / 64] |= static_cast<uint64_t>(cells[i] >= threshold) << (i % 64);
+        }
+    }
+
+    template <typename T>
+    void scanScalarKernel(const T *cells, const size_t count, const T threshold, uint64_t *words)
+    {
+        scanScalar(cells, 0, count, threshold, words);
+    }
+
+#ifdef CLM_X86_KERNELS
+    __attribute__((target("avx2")))
+    void scanAvx2(const uint16_t *cells, const size_t count, const uint16_t threshold, uint64_t *words)
+    {
+        const __m256i bound = _mm256_set1_epi16(static_cast<short>(threshold));
+
+        size_t i = 0;
+        for (; i + 32 <= count; i += 32)
+        {
+            // A cell reaches the bound when the unsigned maximum of both is the cell itself
+            const __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(cells + i));
+            const __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(cells + i + 16));
+            const __m256i lowPass = _mm256_cmpeq_epi16(_mm256_max_epu16(low, bound), low);
+            const __m256i highPass = _mm256_cmpeq_epi16(_mm256_max_epu16(high, bound), high);
+
+            // Packing narrows every lane to a byte but interleaves the 128-bit halves, the permute restores the order
+            const __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi16(lowPass, highPass), 0xD8);
+            const auto bits = static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(packed)));
+            words[i / 64] |= bits << (i % 64);
+        }
+
+        scanScalar(cells, i, count, threshold, words);
+    }
+
+    __attribute__((target("avx2")))
+    void scanAvx2(const uint32_t *cells, const size_t count, const uint32_t threshold, uint64_t *words)
+    {
+        const __m256i bound = _mm256_set1_epi32(static_cast<int>(threshold));
+
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(cells + i));
+            const __m256i pass = _mm256_cmpeq_epi32(_mm256_max_epu32(block, bound), block);
+            const auto bits = static_cast<uint64_t>(_mm256_movemask_ps(_mm256_castsi256_ps(pass)));
+            words[i / 64] |= bits << (i % 64);
+        }
+
+        scanScalar(cells, i, count, threshold, words);
+    }
+
+    __attribute__((target("avx2")))
+    void scanAvx2(const uint64_t *cells, const size_t count, const uint64_t threshold, uint64_t *words)
+    {
+        // AVX2 only compares signed 64-bit lanes, flipping the sign bit of both sides makes that an unsigned compare
+        const __m256i sign = _mm256_set1_epi64x(static_cast<long long>(1ULL << 63));
+        const __m256i bound = _mm256_xor_si256(_mm256_set1_epi64x(static_cast<long long>(threshold)), sign);
+
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            const __m256i block = _mm256_xor_si256(
+                    _mm256_loadu_si256(reinterpret_cast<const __m256i *>(cells + i)), sign);
+            const __m256i below = _mm256_cmpgt_epi64(bound, block);
+            const auto bits = static_cast<uint64_t>(~_mm256_movemask_pd(_mm256_castsi256_pd(below)) & 0xF);
+            words[i / 64] |= bits << (i % 64);
+        }
+
+        scanScalar(cells, i, count, threshold, words);
+    }
+
+    __attribute__((target("avx512f,avx512bw")))
+    void scanAvx512(const uint16_t *cells, const size_t count, const uint16_t threshold, uint64_t *words)
+    {
+        const __m512i bound = _mm512_set1_epi16(static_cast<short>(threshold));
+
+        size_t i = 0;
+        for (; i + 32 <= count; i += 32)
+        {
+            const __m512i block = _mm512_loadu_si512(cells + i);
+            const auto bits = static_cast<uint64_t>(_mm512_cmpge_epu16_mask(block, bound));
+            words[i / 64] |= bits << (i % 64);
+        }
+
+        scanScalar(cells, i, count, threshold, words);
+    }
+
+    __attribute__((target("avx512f")))
+    void scanAvx512(const uint32_t *cells, const size_t count, const uint32_t threshold, uint64_t *words)
+    {
+        const __m512i bound = _mm512_set1_epi32(static_cast<int>(threshold));
+
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16)
+        {
+            const __m512i block = _mm512_loadu_si512(cells + i);
+            const auto bits = static_cast<uint64_t>(_mm512_cmpge_epu32_mask(block, bound));
+            words[i / 64] |= bits << (i % 64);
+        }
+
+        scanScalar(cells, i, count, threshold, words);
+    }
+
+    __attribute__((target("avx512f")))
+    void scanAvx512(const uint64_t *cells, const size_t count, const uint64_t threshold, uint64_t *words)
+    {
+        const __m512i bound = _mm512_set1_epi64(static_cast<long long>(threshold));
+
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            const __m512i block = _mm512_loadu_si512(cells + i);
+            const auto bits = static_cast<uint64_t>(_mm512_cmpge_epu64_mask(block, bound));
+            words[i / 64] |= bits << (i % 64);
+        }
+
+        scanScalar(cells, i, count, threshold, words);
+    }
+#endif
+
+    // One kernel per cell width
+    struct Kernels {
+      Kernel<uint16_t> scan16 = scanScalarKernel<uint16_t>;
+      Kernel<uint32_t> scan32 = scanScalarKernel<uint32_t>;
+      Kernel<uint64_t> scan64 = scanScalarKernel<uint64_t>;
+      const char *name = "scalar";
+
+      [[nodiscard]] Kernel<uint16_t> get(const uint16_t *) const noexcept
+      {
+          return scan16;
+      }
+
+      [[nodiscard]] Kernel<uint32_t> get(const uint32_t *) const noexcept
+      {
+          return scan32;
+      }
+
+      [[nodiscard]] Kernel<uint64_t> get(const uint64_t *) const noexcept
+      {
+          return scan64;
+      }
+    };
+
+    const Kernels &selectedKernels() noexcept
+    {
+        static const Kernels kernels = []
+        {
+#ifdef CLM_X86_KERNELS
+            // CLM_THRESHOLD_KERNEL caps the selection, which makes the kernels comparable on a single machine
+            const char *cap = std::getenv("CLM_THRESHOLD_KERNEL");
+            const auto allowed = [cap](const char *name)
+            {
+                return cap == nullptr || std::strcmp(cap, name) == 0 ||
+                       (std::strcmp(cap, "avx512") == 0 && std::strcmp(name, "avx2") == 0);
+            };
+
+            __builtin_cpu_init();
+            if (allowed("avx512") && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+                return Kernels{scanAvx512, scanAvx512, scanAvx512, "avx512"};
+            if (allowed("avx2") && __builtin_cpu_supports("avx2"))
+                return Kernels{scanAvx2, scanAvx2, scanAvx2, "avx2"};
+#endif
+            return Kernels{};
+        }();
+
+        return kernels;
+    }
+
+    template <typename T>
+    void scanCells(std::vector<uint64_t> &words, const std::span<const T> cells, const size_t threshold)
+    {
+        words.assign((cells.size() + 63) / 64, 0);
+
+        // No cell of a narrow width can reach a threshold above its maximum
+        if (threshold > std::numeric_limits<T>::max())
+            return;
+
+        selectedKernels().get(cells.data())(cells.data(), cells.size(), static_cast<T>(threshold), words.data());
+    }
+}
+
+void ThresholdMask::scan(const std::span<const uint16_t> cells, const size_t threshold)
+{
+    scanCells(words, cells, threshold);
+}
+
+void ThresholdMask::scan(const std::span<const uint32_t> cells, const size_t threshold)
+{
+    scanCells(words, cells, threshold);
+}
+
+void ThresholdMask::scan(const std::span<const uint64_t> cells, const size_t threshold)
+{
+    scanCells(words, cells, threshold);
+}
+
+const char *ThresholdMask::kernel() noexcept
+{
+    return selectedKernels().name;
+}